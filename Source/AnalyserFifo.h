@@ -0,0 +1,91 @@
+#pragma once
+#include <JuceHeader.h>
+
+//==============================================================================
+// Single producer, single consumer queue that hands the post-chain audio from the
+// audio thread to the analyser. Pushing never blocks or allocates; when the reader
+// falls behind, whatever doesn't fit is dropped.
+class AnalyserFifo
+{
+public:
+    static constexpr int numChannels = 2;
+    static constexpr int capacity = 16384;
+
+    // Called by the reader before it starts pulling. Instances whose analyser is never
+    // opened don't pay for the storage, and once allocated it never moves, so the audio
+    // thread can start pushing as soon as it sees the flag.
+    void allocate()
+    {
+        if (! isAllocated.load(std::memory_order_acquire))
+        {
+            buffer.setSize(numChannels, capacity);
+            buffer.clear();
+            isAllocated.store(true, std::memory_order_release);
+        }
+    }
+
+    void setSampleRate(double newSampleRate) noexcept
+    {
+        sampleRate.store(newSampleRate);
+    }
+
+    double getSampleRate() const noexcept
+    {
+        return sampleRate.load();
+    }
+
+    // Called from the audio thread: one copy per channel into the ring. Double
+    // precision audio is narrowed to float on the way in.
+    template <typename SampleType>
+    void push(const juce::AudioBuffer<SampleType>& source, int numSamples) noexcept
+    {
+        const auto numSourceChannels = source.getNumChannels();
+
+        if (! isAllocated.load(std::memory_order_acquire) || numSourceChannels == 0)
+            return;
+
+        const auto scope = fifo.write(numSamples);
+
+        for (auto ch = 0; ch < numChannels; ++ch)
+        {
+            const auto* sourceData = source.getReadPointer(juce::jmin(ch, numSourceChannels - 1));
+
+            if (scope.blockSize1 > 0)
+                std::copy(sourceData, sourceData + scope.blockSize1, buffer.getWritePointer(ch, scope.startIndex1));
+
+            if (scope.blockSize2 > 0)
+                std::copy(sourceData + scope.blockSize1, sourceData + scope.blockSize1 + scope.blockSize2,
+                          buffer.getWritePointer(ch, scope.startIndex2));
+        }
+    }
+
+    // Called from the analyser thread: reads up to maxSamples of the mono sum into dest
+    // and returns how many were read.
+    int pop(float* dest, int maxSamples) noexcept
+    {
+        if (! isAllocated.load(std::memory_order_acquire))
+            return 0;
+
+        const auto scope = fifo.read(juce::jmin(maxSamples, fifo.getNumReady()));
+
+        auto sumChannels = [this, dest](int destStart, int start, int size)
+        {
+            if (size <= 0)
+                return;
+
+            juce::FloatVectorOperations::copyWithMultiply(dest + destStart, buffer.getReadPointer(0, start), 0.5f, size);
+            juce::FloatVectorOperations::addWithMultiply(dest + destStart, buffer.getReadPointer(1, start), 0.5f, size);
+        };
+
+        sumChannels(0, scope.startIndex1, scope.blockSize1);
+        sumChannels(scope.blockSize1, scope.startIndex2, scope.blockSize2);
+
+        return scope.blockSize1 + scope.blockSize2;
+    }
+
+private:
+    juce::AbstractFifo fifo{ capacity };
+    juce::AudioBuffer<float> buffer;
+    std::atomic<bool> isAllocated{ false };
+    std::atomic<double> sampleRate{ 44.1e3 };
+};
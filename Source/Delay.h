@@ -0,0 +1,675 @@
+#pragma once
+#include <JuceHeader.h>
+#include "Ducker.h"
+#include "HalfBandFilter.h"
+#include "SimdKernels.h"
+
+//==============================================================================
+// Converts between the processing sample type and the type a DelayLine stores.
+template <typename Type, typename StorageType>
+struct DelaySampleConverter
+{
+    static StorageType toStorage(Type value) noexcept   { return static_cast<StorageType>(value); }
+    static Type fromStorage(StorageType value) noexcept { return static_cast<Type>(value); }
+};
+
+// 16-bit storage, half the memory of float lines. The delay line input comes out
+// of the saturator, so it is already within [-1, 1], and it is written with TPDF
+// dither so the quantisation error is noise rather than distortion that builds up
+// around the feedback loop. The dither is a hash of a running count of the samples
+// written, the same one SimdKernels::samplesToStorage uses for blocks.
+template <typename Type>
+struct DelaySampleConverter<Type, int16_t>
+{
+    int16_t toStorage(Type value) noexcept
+    {
+        auto hash = ditherCount++ * 0x9e3779b9u;
+        hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+        hash ^= hash >> 13;
+        const auto dither = (Type)((int32_t)(hash & 0xffff) - (int32_t)(hash >> 16)) * Type(1.0 / 65536.0);
+
+        // Rounded the way the kernel rounds, so single samples and blocks match
+        auto scaled = (int32_t)(juce::jlimit(Type(-1), Type(1), value) * Type(32767) + dither + Type(32768.5)) - 32768;
+        return static_cast<int16_t>(juce::jlimit(-32767, 32767, scaled));
+    }
+
+    static Type fromStorage(int16_t value) noexcept
+    {
+        return static_cast<Type>(value) * Type(1.0 / 32767.0);
+    }
+
+    uint32_t ditherCount{ 0 };
+};
+
+//==============================================================================
+template <typename Type, typename StorageType = Type>
+class DelayLine
+{
+public:
+    using Converter = DelaySampleConverter<Type, StorageType>;
+
+    void clear() noexcept
+    {
+        std::fill(rawData.begin(), rawData.end(), StorageType(0));
+    }
+
+    size_t size() const noexcept
+    {
+        return rawData.size();
+    }
+
+    // Clears the line, only reallocating when it needs to grow past its current capacity
+    void resize(size_t newValue)
+    {
+        rawData.assign(newValue, StorageType(0));
+        leastRecentIndex = 0;
+    }
+
+    Type back() const noexcept
+    {
+        return Converter::fromStorage(rawData[leastRecentIndex]);
+    }
+
+    Type get(size_t delayInSamples) const noexcept
+    {
+        jassert(delayInSamples >= 0 && delayInSamples < size());
+        return Converter::fromStorage(rawData[(leastRecentIndex + 1 + delayInSamples) % size()]);
+    }
+
+    void set(size_t delayInSamples, Type newValue) noexcept
+    {
+        jassert(delayInSamples >= 0 && delayInSamples < size());
+        rawData[(leastRecentIndex + 1 + delayInSamples) % size()] = converter.toStorage(newValue);
+    }
+
+    // Index of the most recent sample, for reading a fixed stretch of the line by
+    // offset from it while the line is no longer being pushed
+    size_t getNewestIndex() const noexcept
+    {
+        return (leastRecentIndex + 1) % size();
+    }
+
+    Type getFrom(size_t newestIndex, size_t delayInSamples) const noexcept
+    {
+        jassert(delayInSamples < size());
+        return Converter::fromStorage(rawData[(newestIndex + delayInSamples) % size()]);
+    }
+
+    void push(Type valueToAdd) noexcept
+    {
+        rawData[leastRecentIndex] = converter.toStorage(valueToAdd);
+        leastRecentIndex = leastRecentIndex == 0 ? size() - 1 : leastRecentIndex - 1;
+    }
+
+    //==============================================================================
+    // Block versions of get and push for 16-bit lines, converting in the SIMD kernels.
+    // read fills dest with what get(delayInSamples) would return before each of the
+    // next numSamples pushes, so none of them may be pushed in the same block:
+    // numSamples must be at most delayInSamples + 1.
+    void read(size_t delayInSamples, Type* dest, size_t numSamples, const SimdKernels::Table& kernels) const noexcept
+    {
+        static_assert(std::is_same<StorageType, int16_t>::value, "Only 16-bit lines are converted in blocks");
+        jassert(numSamples <= delayInSamples + 1 && delayInSamples < size());
+
+        // The line runs downwards from the newest sample, so this is at most two runs
+        const auto start = (leastRecentIndex + 1 + delayInSamples) % size();
+        const auto first = juce::jmin(numSamples, start + 1);
+        SimdKernels::storageToSamples(kernels, rawData.data() + start, dest, first);
+
+        if (first < numSamples)
+            SimdKernels::storageToSamples(kernels, rawData.data() + size() - 1, dest + first, numSamples - first);
+    }
+
+    void push(const Type* source, size_t numSamples, const SimdKernels::Table& kernels) noexcept
+    {
+        static_assert(std::is_same<StorageType, int16_t>::value, "Only 16-bit lines are converted in blocks");
+        jassert(numSamples <= size());
+
+        const auto first = juce::jmin(numSamples, leastRecentIndex + 1);
+        SimdKernels::samplesToStorage(kernels, source, rawData.data() + leastRecentIndex, first, converter.ditherCount);
+
+        if (first < numSamples)
+            SimdKernels::samplesToStorage(kernels, source + first, rawData.data() + size() - 1, numSamples - first,
+                                          converter.ditherCount + (uint32_t)first);
+
+        converter.ditherCount += (uint32_t)numSamples;
+        leastRecentIndex = (leastRecentIndex + size() - numSamples) % size();
+    }
+
+private:
+    std::vector<StorageType> rawData;
+    size_t leastRecentIndex = 0;
+    Converter converter;
+};
+
+//==============================================================================
+template <typename Type, size_t maxNumChannels = 2, typename StorageType = Type>
+class Delay
+{
+public:
+    //==============================================================================
+    Delay()
+    {
+        setMaxDelayTime(2.1f);
+
+        for (size_t ch = 0; ch < maxNumChannels; ++ch)
+            setDelayTime(ch, 0.5f);
+
+        setWetLevel(0.5f);
+        setFeedback(0.5f);
+    }
+
+    //==============================================================================
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        jassert(spec.numChannels <= maxNumChannels);
+        decimation = requestedDecimation;
+        sampleRate = Type(spec.sampleRate / (double)decimation);
+        isPrepared = true;
+        updateDelayLineSize();
+        updateDelayTime();
+
+        filterCoefs = getHighPassCoefficients(sampleRate);
+
+        for (auto& f : filters)
+        {
+            f.prepare(spec);
+            f.coefficients = filterCoefs;
+        }
+
+        for (auto& d : duckers)
+            d.prepare(spec.sampleRate);
+
+        for (auto& r : reducers)
+            r.setFactor((int)decimation);
+
+        resetDecimation();
+
+        if constexpr (convertsBlocks)
+        {
+            kernels = &SimdKernels::getKernels();
+            blockSamples.resize((size_t)spec.maximumBlockSize);
+        }
+
+        fastSaturationMixes.fill(useFastSaturation ? Type(1) : Type(0));
+        freezeTarget = false;
+
+        for (auto& gain : freezeGains)
+        {
+            gain.reset(sampleRate, freezeFadeSeconds);
+            gain.setCurrentAndTargetValue(Type(0));
+        }
+    }
+
+    //==============================================================================
+    void reset() noexcept
+    {
+        for (auto& f : filters)
+            f.reset();
+
+        for (auto& dline : delayLines)
+            dline.clear();
+
+        for (auto& d : duckers)
+            d.reset();
+
+        for (auto& s : saturators)
+            s.reset();
+
+        resetDecimation();
+    }
+
+    //==============================================================================
+    size_t getNumChannels() const noexcept
+    {
+        return delayLines.size();
+    }
+
+    //==============================================================================
+    void setMaxDelayTime(Type newValue)
+    {
+        jassert(newValue > Type(0));
+        maxDelayTime = newValue;
+        updateDelayLineSize();
+    }
+
+    //==============================================================================
+    void setFeedback(Type newValue) noexcept
+    {
+        jassert(newValue >= Type(0) && newValue <= Type(1));
+        feedback = newValue;
+    }
+
+    //==============================================================================
+    // Optional block that receives the wet signal on its own, for a stem output.
+    // An empty block stops it being written.
+    void setWetOutput(const juce::dsp::AudioBlock<Type>& newWetOutput) noexcept
+    {
+        wetOutput = newWetOutput;
+    }
+
+    //==============================================================================
+    // Ducks the echoes under a key signal: the block set with setDuckingKey, or the
+    // delay's own input when that block is empty
+    void setDucking(Type amount, Type releaseTime) noexcept
+    {
+        for (auto& d : duckers)
+        {
+            d.setAmount(amount);
+            d.setReleaseTime(releaseTime);
+        }
+    }
+
+    void setDuckingKey(const juce::dsp::AudioBlock<Type>& newKey) noexcept
+    {
+        duckingKey = newKey;
+    }
+
+    //==============================================================================
+    // Stops writing into the lines and loops the last delay time's worth of each one
+    // in place, as if the feedback were pinned at unity with no filter or saturation.
+    // Engaging and releasing fade over a few milliseconds, and the loop seam is
+    // crossfaded with the audio that originally led into the loop's start.
+    void setFreeze(bool shouldFreeze) noexcept
+    {
+        if (shouldFreeze == freezeTarget)
+            return;
+
+        freezeTarget = shouldFreeze;
+
+        for (size_t ch = 0; ch < maxNumChannels; ++ch)
+        {
+            // Re-engaging while the previous loop is still fading out keeps that loop
+            if (shouldFreeze && freezeGains[ch].getCurrentValue() == Type(0))
+                captureFrozenLoop(ch);
+
+            freezeGains[ch].setTargetValue(shouldFreeze ? Type(1) : Type(0));
+        }
+    }
+
+    //==============================================================================
+    // Swaps std::tanh in the feedback loop for a cheaper rational approximation.
+    // A switch crossfades the two curves over saturationFadeLength loop samples,
+    // the way the saturator's oversampling changes are, so it doesn't click.
+    void setFastSaturation(bool shouldUseFastSaturation) noexcept
+    {
+        useFastSaturation = shouldUseFastSaturation;
+    }
+
+    // Runs the feedback saturator alone at 1x, 2x or 4x the sample rate, which keeps
+    // the harmonics it adds at high feedback from aliasing back down. Its latency is
+    // the same at every factor and is taken off the delay time, and a change is
+    // crossfaded, so it can be switched while audio is running.
+    void setSaturationOversampling(int factor) noexcept
+    {
+        for (auto& s : saturators)
+            s.setFactor(factor);
+    }
+
+    // Runs the feedback loop at 1/2 or 1/4 of the sample rate: the input is decimated
+    // into it and the echoes are interpolated back up before they meet the dry signal.
+    // The lines shrink and the loop costs less by the same factor, but the echoes lose
+    // everything above 0.46 of the reduced rate, and delay times are rounded to the
+    // reduced rate. Takes effect on the next prepare.
+    void setWetDecimation(int factor) noexcept
+    {
+        jassert(factor == 1 || factor == 2 || factor == 4);
+        requestedDecimation = factor == 4 ? 4 : (factor == 2 ? 2 : 1);
+    }
+
+    //==============================================================================
+    void setWetLevel(Type newValue) noexcept
+    {
+        jassert(newValue >= Type(0) && newValue <= Type(1));
+        wetLevel = newValue;
+    }
+
+    //==============================================================================
+    void setDelayTime(size_t channel, Type newValue)
+    {
+        if (channel >= getNumChannels())
+        {
+            jassertfalse;
+            return;
+        }
+
+        jassert(newValue >= Type(0));
+        delayTimes[channel] = newValue;
+
+        updateDelayTime();
+    }
+
+    //==============================================================================
+    // The high-pass coefficients only depend on the sample rate, so every instance
+    // running at the same rate shares one read-only set. EchoBank uses them too.
+    static typename juce::dsp::IIR::Coefficients<Type>::Ptr getHighPassCoefficients(Type rate)
+    {
+        static juce::CriticalSection lock;
+        static std::map<Type, typename juce::dsp::IIR::Coefficients<Type>::Ptr> cache;
+
+        const juce::ScopedLock sl(lock);
+        auto& coefs = cache[rate];
+
+        if (coefs == nullptr)
+            coefs = juce::dsp::IIR::Coefficients<Type>::makeFirstOrderHighPass(rate, Type(1e3));
+
+        return coefs;
+    }
+
+    //==============================================================================
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        auto& inputBlock = context.getInputBlock();
+        auto& outputBlock = context.getOutputBlock();
+        auto numSamples = outputBlock.getNumSamples();
+        auto numChannels = outputBlock.getNumChannels();
+
+        jassert(inputBlock.getNumSamples() == numSamples);
+        jassert(inputBlock.getNumChannels() == numChannels);
+
+        if (context.isBypassed)
+        {
+            if (context.usesSeparateInputAndOutputBlocks())
+                outputBlock.copyFrom(inputBlock);
+
+            return;
+        }
+
+        juce::ignoreUnused(numSamples);
+
+        for (size_t ch = 0; ch < numChannels; ++ch)
+        {
+            auto* input = inputBlock.getChannelPointer(ch);
+            auto* output = outputBlock.getChannelPointer(ch);
+            auto& dline = delayLines[ch];
+            auto& saturator = saturators[ch];
+            auto loopLatency = (size_t)(saturator.getLatency() + reducers[ch].getLatency() / (int)decimation);
+            auto delayTime = delayTimesSample[ch] - juce::jmin(delayTimesSample[ch], loopLatency);
+            auto& filter = filters[ch];
+            auto* wet = ch < wetOutput.getNumChannels() ? wetOutput.getChannelPointer(ch) : nullptr;
+            auto* key = ch < duckingKey.getNumChannels() ? duckingKey.getChannelPointer(ch) : input;
+            auto& ducker = duckers[ch];
+            auto isDucking = ducker.isActive();
+            auto& freezeGain = freezeGains[ch];
+            auto shaper = [this, ch](Type x) { return saturate(ch, x); };
+
+            auto writeOutput = [&](size_t i, Type inputSample, Type delayedSample)
+            {
+                auto wetGain = isDucking ? wetLevel * ducker.processSample(key[i]) : wetLevel;
+                auto wetSample = wetGain * delayedSample;
+                output[i] = inputSample + wetSample;
+
+                if (wet != nullptr)
+                    wet[i] = wetSample;
+            };
+
+            if (decimation > 1)
+            {
+                // The loop steps once every decimation samples, and its echoes come out
+                // over the following decimation samples
+                auto& reducer = reducers[ch];
+                auto& reducerInput = reducerInputs[ch];
+                auto& reducerOutput = reducerOutputs[ch];
+                auto phase = decimationPhase;
+
+                for (size_t i = 0; i < numSamples; ++i)
+                {
+                    auto inputSample = input[i];
+                    auto delayedSample = reducerOutput[phase];
+                    reducerInput[phase] = inputSample;
+
+                    if (++phase == decimation)
+                    {
+                        phase = 0;
+                        auto reducedSample = processLoopSample(ch, reducer.downsample(reducerInput.data()), delayTime);
+                        reducer.upsample(reducedSample, reducerOutput.data());
+                    }
+
+                    writeOutput(i, inputSample, delayedSample);
+                }
+            }
+            else if (! freezeTarget && freezeGain.getCurrentValue() == Type(0))
+            {
+                // Whole blocks through the 16-bit line, when the delay is long enough
+                // that nothing the block pushes is read back in it
+                if constexpr (convertsBlocks)
+                {
+                    if (numSamples <= blockSamples.size() && numSamples <= delayTime + 1)
+                    {
+                        auto* samples = blockSamples.data();
+                        dline.read(delayTime, samples, numSamples, *kernels);
+
+                        for (size_t i = 0; i < numSamples; ++i)
+                        {
+                            auto delayedSample = filter.processSample(samples[i]);
+                            auto inputSample = input[i];
+                            stepSaturationFade(ch);
+                            samples[i] = saturator.processSample(inputSample + feedback * delayedSample, shaper);
+                            writeOutput(i, inputSample, delayedSample);
+                        }
+
+                        dline.push(samples, numSamples, *kernels);
+                        continue;
+                    }
+                }
+
+                for (size_t i = 0; i < numSamples; ++i)
+                {
+                    auto delayedSample = filter.processSample(dline.get(delayTime));
+                    auto inputSample = input[i];
+                    stepSaturationFade(ch);
+                    auto dlineInputSample = saturator.processSample(inputSample + feedback * delayedSample, shaper);
+                    dline.push(dlineInputSample);
+                    writeOutput(i, inputSample, delayedSample);
+                }
+            }
+            else
+            {
+                // Once fully frozen the feedback path is skipped altogether
+                for (size_t i = 0; i < numSamples; ++i)
+                {
+                    auto inputSample = input[i];
+                    auto frozen = freezeGain.getNextValue();
+                    auto delayedSample = Type(0);
+
+                    if (frozen < Type(1))
+                    {
+                        delayedSample = filter.processSample(dline.get(delayTime));
+                        stepSaturationFade(ch);
+                        dline.push(saturator.processSample(inputSample + feedback * delayedSample, shaper));
+                    }
+
+                    delayedSample += frozen * (readFrozenLoop(ch) - delayedSample);
+                    writeOutput(i, inputSample, delayedSample);
+                }
+            }
+        }
+
+        decimationPhase = (decimationPhase + numSamples) % decimation;
+    }
+
+private:
+    std::array<DelayLine<Type, StorageType>, maxNumChannels> delayLines;
+
+    // 16-bit lines are read and written a block at a time through here
+    static constexpr bool convertsBlocks = std::is_same<StorageType, int16_t>::value;
+    const SimdKernels::Table* kernels{ nullptr };
+    std::vector<Type> blockSamples;
+    std::array<size_t, maxNumChannels> delayTimesSample;
+    std::array<Type, maxNumChannels> delayTimes;
+    Type feedback{ Type(0) };
+    Type wetLevel{ Type(0) };
+    juce::dsp::AudioBlock<Type> wetOutput, duckingKey;
+    std::array<Ducker<Type>, maxNumChannels> duckers;
+    std::array<OversampledSaturator<Type>, maxNumChannels> saturators;
+
+    // How far each channel's shaper has faded from std::tanh to the approximation
+    static constexpr int saturationFadeLength = OversampledSaturator<Type>::fadeLength;
+    bool useFastSaturation{ false };
+    std::array<Type, maxNumChannels> fastSaturationMixes{};
+
+    // A stretch of a line being looped in place: length samples counted back from
+    // the anchor, which was the newest sample when the freeze engaged
+    struct FrozenLoop
+    {
+        size_t anchor{ 0 }, length{ 1 }, position{ 0 }, seamLength{ 0 };
+    };
+
+    static constexpr Type freezeFadeSeconds{ Type(0.02) };
+    static constexpr Type maxSeamSeconds{ Type(0.01) };
+    bool freezeTarget{ false };
+    std::array<juce::LinearSmoothedValue<Type>, maxNumChannels> freezeGains;
+    std::array<FrozenLoop, maxNumChannels> frozenLoops;
+
+    std::array<juce::dsp::IIR::Filter<Type>, maxNumChannels> filters;
+    typename juce::dsp::IIR::Coefficients<Type>::Ptr filterCoefs;
+
+    // Decimating the wet path: each channel's reducer, the full-rate samples waiting to
+    // go down into the loop and the ones that came back up, and how many are waiting
+    static constexpr size_t maxDecimation = 4;
+    int requestedDecimation{ 1 };
+    size_t decimation{ 1 }, decimationPhase{ 0 };
+    std::array<RateReducer<Type>, maxNumChannels> reducers;
+    std::array<std::array<Type, maxDecimation>, maxNumChannels> reducerInputs, reducerOutputs;
+
+    // The rate the feedback loop runs at, which is the host's over the decimation
+    Type sampleRate{ Type(44.1e3) };
+    Type maxDelayTime{ Type(2) };
+    bool isPrepared{ false };
+
+    //==============================================================================
+    // The lines are only allocated once the sample rate is known, so constructing a
+    // Delay and setting its maximum time up front costs nothing.
+    void updateDelayLineSize()
+    {
+        if (! isPrepared)
+            return;
+
+        auto delayLineSizeSamples = (size_t)std::ceil(maxDelayTime * sampleRate);
+
+        for (auto& dline : delayLines)
+        {
+            dline.resize(delayLineSizeSamples);
+        }
+    }
+
+    //==============================================================================
+    void captureFrozenLoop(size_t ch) noexcept
+    {
+        auto& dline = delayLines[ch];
+        auto& loop = frozenLoops[ch];
+
+        if (dline.size() == 0)
+            return;
+
+        // The line keeps being written while the freeze fades in and out, which eats
+        // into the oldest samples, so the seam only uses what is left beyond that
+        const auto fadeSamples = (size_t)juce::roundToInt(freezeFadeSeconds * sampleRate);
+        loop.anchor = dline.getNewestIndex();
+        loop.length = juce::jmin(delayTimesSample[ch] + 1, dline.size());
+        loop.position = 0;
+
+        const auto spare = dline.size() > loop.length + 2 * fadeSamples ? dline.size() - loop.length - 2 * fadeSamples : 0;
+        const auto maxSeam = (size_t)juce::roundToInt(maxSeamSeconds * sampleRate);
+        loop.seamLength = juce::jmin(juce::jmin(loop.length / 4, maxSeam), spare);
+    }
+
+    Type readFrozenLoop(size_t ch) noexcept
+    {
+        auto& dline = delayLines[ch];
+        auto& loop = frozenLoops[ch];
+
+        // Position 0 is the oldest sample of the loop
+        auto offset = loop.length - 1 - loop.position;
+        auto sample = dline.getFrom(loop.anchor, offset);
+        auto seamStart = loop.length - loop.seamLength;
+
+        // Towards the end, fade into the samples that preceded the loop's start so
+        // that the wrap back to position 0 continues where they left off
+        if (loop.position >= seamStart)
+        {
+            auto t = Type(loop.position - seamStart + 1) / Type(loop.seamLength + 1);
+            sample += t * (dline.getFrom(loop.anchor, offset + loop.length) - sample);
+        }
+
+        loop.position = loop.position + 1 == loop.length ? 0 : loop.position + 1;
+        return sample;
+    }
+
+    // One step of the feedback loop at the reduced rate, freeze included
+    Type processLoopSample(size_t ch, Type inputSample, size_t delayTime) noexcept
+    {
+        auto frozen = freezeGains[ch].getNextValue();
+        auto delayedSample = Type(0);
+
+        if (frozen < Type(1))
+        {
+            delayedSample = filters[ch].processSample(delayLines[ch].get(delayTime));
+            stepSaturationFade(ch);
+            delayLines[ch].push(saturators[ch].processSample(inputSample + feedback * delayedSample,
+                                                             [this, ch](Type x) { return saturate(ch, x); }));
+        }
+
+        if (frozen > Type(0))
+            delayedSample += frozen * (readFrozenLoop(ch) - delayedSample);
+
+        return delayedSample;
+    }
+
+    void resetDecimation() noexcept
+    {
+        for (auto& r : reducers)
+            r.reset();
+
+        for (auto& samples : reducerInputs)
+            samples.fill(Type(0));
+
+        for (auto& samples : reducerOutputs)
+            samples.fill(Type(0));
+
+        decimationPhase = 0;
+    }
+
+    //==============================================================================
+    // Pade approximant of tanh, which reaches exactly +/-1 at +/-3
+    static Type fastTanh(Type x) noexcept
+    {
+        x = juce::jlimit(Type(-3), Type(3), x);
+        return x * (Type(27) + x * x) / (Type(27) + Type(9) * x * x);
+    }
+
+    // Only computes both curves while a switch between them is fading
+    Type saturate(size_t ch, Type x) const noexcept
+    {
+        const auto mix = fastSaturationMixes[ch];
+
+        if (mix == Type(0))
+            return std::tanh(x);
+
+        auto fast = fastTanh(x);
+
+        if (mix == Type(1))
+            return fast;
+
+        return fast + (Type(1) - mix) * (std::tanh(x) - fast);
+    }
+
+    void stepSaturationFade(size_t ch) noexcept
+    {
+        auto& mix = fastSaturationMixes[ch];
+        const auto step = Type(1) / Type(saturationFadeLength);
+
+        if (useFastSaturation)
+            mix = juce::jmin(Type(1), mix + step);
+        else
+            mix = juce::jmax(Type(0), mix - step);
+    }
+
+    //==============================================================================
+    void updateDelayTime() noexcept
+    {
+        for (size_t ch = 0; ch < maxNumChannels; ++ch)
+            delayTimesSample[ch] = (size_t)juce::roundToInt(delayTimes[ch] * sampleRate);
+    }
+};
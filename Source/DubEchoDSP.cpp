@@ -0,0 +1,354 @@
+#include <JuceHeader.h>
+#include "DubEchoDSP.h"
+#include "Delay.h"
+#include "SimdKernels.h"
+
+namespace dubecho
+{
+    // Same headroom the plugin leaves above the longest delay time
+    static constexpr float lineHeadroom = 1.05f;
+
+    //==============================================================================
+    struct EchoChain::Impl
+    {
+        explicit Impl(int channels) : numChannels((size_t)juce::jlimit(1, 2, channels))
+        {
+            jassert(channels == 1 || channels == 2);
+            delay.setMaxDelayTime(maxDelayTime * lineHeadroom);
+        }
+
+        size_t numChannels;
+        std::array<juce::dsp::Reverb, 2> reverbs;
+        Delay<float, 2> delay;
+    };
+
+    EchoChain::EchoChain(int numChannels) : impl(std::make_unique<Impl>(numChannels)) {}
+    EchoChain::~EchoChain() = default;
+
+    void EchoChain::prepare(double sampleRate, int maximumBlockSize)
+    {
+        juce::dsp::ProcessSpec spec{ sampleRate, (juce::uint32)maximumBlockSize, 1 };
+
+        for (auto& reverb : impl->reverbs)
+            reverb.prepare(spec);
+
+        spec.numChannels = (juce::uint32)impl->numChannels;
+        impl->delay.prepare(spec);
+    }
+
+    void EchoChain::reset()
+    {
+        for (auto& reverb : impl->reverbs)
+            reverb.reset();
+
+        impl->delay.reset();
+    }
+
+    void EchoChain::setSettings(const EchoSettings& newSettings)
+    {
+        for (size_t ch = 0; ch < impl->numChannels; ++ch)
+            impl->delay.setDelayTime(ch, juce::jlimit(0.f, maxDelayTime, newSettings.delayTime));
+
+        impl->delay.setFeedback(newSettings.delayFeedback);
+        impl->delay.setWetLevel(newSettings.delayWet);
+
+        // The same mapping the plugin uses
+        juce::dsp::Reverb::Parameters parameters;
+        parameters.roomSize = newSettings.reverbSize;
+        parameters.damping = newSettings.reverbDamping;
+        parameters.wetLevel = newSettings.reverbWet;
+        parameters.dryLevel = 1.f - newSettings.reverbWet;
+
+        for (auto& reverb : impl->reverbs)
+            reverb.setParameters(parameters);
+    }
+
+    void EchoChain::process(float* const* channels, int numSamples)
+    {
+        juce::dsp::AudioBlock<float> block(channels, impl->numChannels, (size_t)numSamples);
+
+        // One mono reverb per channel, as in the plugin's per-channel chains
+        for (size_t ch = 0; ch < impl->numChannels; ++ch)
+        {
+            auto channelBlock = block.getSingleChannelBlock(ch);
+            impl->reverbs[ch].process(juce::dsp::ProcessContextReplacing<float>(channelBlock));
+        }
+
+        impl->delay.process(juce::dsp::ProcessContextReplacing<float>(block));
+    }
+
+    //==============================================================================
+    namespace
+    {
+        // juce::Reverb's comb and allpass lengths at 44.1 kHz for its first channel,
+        // which is the one its mono path and so each of the plugin's chains uses
+        constexpr int combTunings[] = { 1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617 };
+        constexpr int allPassTunings[] = { 556, 441, 341, 225 };
+        constexpr size_t numCombs = std::size(combTunings), numAllPasses = std::size(allPassTunings);
+
+        // And the constants its setParameters maps EchoSettings through
+        constexpr float reverbInputGain = 0.015f;
+        constexpr double reverbSmoothingSeconds = 0.01;
+
+        constexpr auto numReverbParameters = (size_t)SimdKernels::numBankReverbParameters;
+        static_assert(numCombs == SimdKernels::bankCombs && numAllPasses == SimdKernels::bankAllPasses);
+
+        // Lanes are padded to a multiple of this so every lane loop runs whole vectors,
+        // 16 floats being one AVX-512 register
+        constexpr size_t laneAlignment = 16;
+    }
+
+    //==============================================================================
+    struct EchoBank::Impl
+    {
+        Impl(int voices, int channelsPerVoice)
+            : numVoices((size_t)juce::jmax(1, voices)),
+              numChannelsPerVoice((size_t)juce::jlimit(1, 2, channelsPerVoice)),
+              numLanes(numVoices * numChannelsPerVoice),
+              stride((numLanes + laneAlignment - 1) / laneAlignment * laneAlignment)
+        {
+            jassert(voices > 0);
+            jassert(channelsPerVoice == 1 || channelsPerVoice == 2);
+            voiceSettings.resize(numVoices);
+            bank.stride = stride;
+            bank.reverbInputGain = reverbInputGain;
+        }
+
+        // Carves the one allocation up: the audio state first, so reset can clear it
+        // in one go, then the per-lane settings and the scratch frames
+        void allocate(size_t maximumBlockSize)
+        {
+            const auto scaled = [this](int tuning) { return (size_t)juce::jmax(1, (int)sampleRate * tuning / 44100); };
+            auto total = (size_t)0;
+
+            for (size_t c = 0; c < numCombs; ++c)
+            {
+                bank.combLengths[c] = scaled(combTunings[c]);
+                total += (bank.combLengths[c] + 1) * stride;
+            }
+
+            for (size_t a = 0; a < numAllPasses; ++a)
+            {
+                bank.allPassLengths[a] = scaled(allPassTunings[a]);
+                total += bank.allPassLengths[a] * stride;
+            }
+
+            lineLength = (size_t)std::ceil(maxDelayTime * lineHeadroom * sampleRate) + 2;
+            bank.lineSize = lineLength * stride;
+            stateSize = total + (1 + lineLength) * stride;
+            ioCapacity = juce::jmax((size_t)1, maximumBlockSize);
+
+            memory.assign(stateSize + (3 * numReverbParameters + 4) * stride + ioCapacity * stride, 0.f);
+            tapOffsets.assign(stride, 0);
+
+            auto* next = memory.data();
+            auto take = [&next](size_t numFloats) { auto* p = next; next += numFloats; return p; };
+
+            for (size_t c = 0; c < numCombs; ++c)
+            {
+                bank.combLast[c] = take(stride);
+                bank.combBuffers[c] = take(bank.combLengths[c] * stride);
+            }
+
+            for (size_t a = 0; a < numAllPasses; ++a)
+                bank.allPassBuffers[a] = take(bank.allPassLengths[a] * stride);
+
+            bank.filterStates = take(stride);
+            bank.line = take(bank.lineSize);
+
+            for (size_t p = 0; p < numReverbParameters; ++p)
+            {
+                bank.current[p] = take(stride);
+                bank.steps[p] = take(stride);
+                bank.targets[p] = take(stride);
+            }
+
+            bank.feedbacks = take(stride);
+            bank.wetLevels = take(stride);
+            bank.reverbInputs = take(stride);
+            bank.reverbOutputs = take(stride);
+            ioFrames = take(ioCapacity * stride);
+            bank.tapOffsets = tapOffsets.data();
+        }
+
+        void clearState() noexcept
+        {
+            std::fill(memory.begin(), memory.begin() + (std::ptrdiff_t)stateSize, 0.f);
+            std::fill(std::begin(bank.combPositions), std::end(bank.combPositions), (size_t)0);
+            std::fill(std::begin(bank.allPassPositions), std::end(bank.allPassPositions), (size_t)0);
+            bank.writeOffset = 0;
+
+            for (size_t voice = 0; voice < numVoices; ++voice)
+                updateTaps(voice);
+        }
+
+        // juce::Reverb::setParameters' mapping with the width at 1 and no freeze,
+        // as EchoChain sets it up
+        void applySettings(size_t voice, bool snap) noexcept
+        {
+            const auto& settings = voiceSettings[voice];
+            const float reverbTargets[] = { settings.reverbDamping * 0.4f,
+                                            settings.reverbSize * 0.28f + 0.7f,
+                                            (1.f - settings.reverbWet) * 2.f,
+                                            settings.reverbWet * 3.f };
+
+            for (size_t ch = 0; ch < numChannelsPerVoice; ++ch)
+            {
+                const auto lane = voice * numChannelsPerVoice + ch;
+
+                for (size_t p = 0; p < numReverbParameters; ++p)
+                {
+                    bank.targets[p][lane] = reverbTargets[p];
+
+                    if (snap)
+                        bank.current[p][lane] = reverbTargets[p];
+                }
+
+                bank.feedbacks[lane] = settings.delayFeedback;
+                bank.wetLevels[lane] = settings.delayWet;
+            }
+
+            updateTaps(voice);
+
+            if (snap)
+                return;
+
+            // Every lane ramps from where it is to its target over the smoothing time
+            const auto rampSamples = juce::jmax(1, juce::roundToInt(reverbSmoothingSeconds * sampleRate));
+            bank.rampSamplesLeft = rampSamples;
+
+            for (size_t p = 0; p < numReverbParameters; ++p)
+                for (size_t lane = 0; lane < stride; ++lane)
+                    bank.steps[p][lane] = (bank.targets[p][lane] - bank.current[p][lane]) / (float)rampSamples;
+        }
+
+        // Delay reads delayTime * sampleRate samples back from the sample it last
+        // pushed, so an echo arrives one sample after that
+        void updateTaps(size_t voice) noexcept
+        {
+            const auto delaySamples = (size_t)juce::roundToInt(voiceSettings[voice].delayTime * sampleRate);
+            const auto distance = juce::jlimit((size_t)1, lineLength - 1, delaySamples + 1);
+            const auto writeFrame = bank.writeOffset / stride;
+            const auto tapFrame = (writeFrame + lineLength - distance) % lineLength;
+
+            for (size_t ch = 0; ch < numChannelsPerVoice; ++ch)
+            {
+                const auto lane = voice * numChannelsPerVoice + ch;
+                tapOffsets[lane] = (int32_t)(tapFrame * stride + lane);
+            }
+        }
+
+        const size_t numVoices, numChannelsPerVoice, numLanes, stride;
+        std::vector<EchoSettings> voiceSettings;
+
+        std::vector<float> memory;
+        std::vector<int32_t> tapOffsets;
+        SimdKernels::BankState bank{};
+        const SimdKernels::Table* kernels{ nullptr };
+        size_t stateSize{ 0 }, lineLength{ 0 }, ioCapacity{ 0 };
+        float* ioFrames{ nullptr };
+        double sampleRate{ 0.0 };
+    };
+
+    EchoBank::EchoBank(int numVoices, int numChannelsPerVoice)
+        : impl(std::make_unique<Impl>(numVoices, numChannelsPerVoice)) {}
+
+    EchoBank::~EchoBank() = default;
+
+    int EchoBank::getNumVoices() const noexcept
+    {
+        return (int)impl->numVoices;
+    }
+
+    int EchoBank::getNumChannelsPerVoice() const noexcept
+    {
+        return (int)impl->numChannelsPerVoice;
+    }
+
+    int EchoBank::getFrameStride() const noexcept
+    {
+        return (int)impl->stride;
+    }
+
+    void EchoBank::prepare(double sampleRate, int maximumBlockSize)
+    {
+        auto& bank = impl->bank;
+        impl->sampleRate = sampleRate;
+        impl->allocate((size_t)maximumBlockSize);
+        impl->kernels = &SimdKernels::getKernels();
+
+        // The plugin's feedback high-pass, first order: b0, b1, a1
+        const auto* c = Delay<float>::getHighPassCoefficients((float)sampleRate)->getRawCoefficients();
+        bank.b0 = c[0];
+        bank.b1 = c[1];
+        bank.a1 = c[2];
+
+        bank.rampSamplesLeft = 0;
+        impl->clearState();
+
+        for (size_t voice = 0; voice < impl->numVoices; ++voice)
+            impl->applySettings(voice, true);
+    }
+
+    void EchoBank::reset()
+    {
+        if (! impl->memory.empty())
+            impl->clearState();
+    }
+
+    void EchoBank::setVoiceSettings(int voice, const EchoSettings& newSettings)
+    {
+        jassert(voice >= 0 && (size_t)voice < impl->numVoices);
+        jassert(newSettings.delayFeedback >= 0.f && newSettings.delayFeedback <= 1.f);
+        jassert(newSettings.delayWet >= 0.f && newSettings.delayWet <= 1.f);
+
+        if (voice < 0 || (size_t)voice >= impl->numVoices)
+            return;
+
+        auto& settings = impl->voiceSettings[(size_t)voice];
+        settings = newSettings;
+        settings.delayTime = juce::jlimit(0.f, maxDelayTime, settings.delayTime);
+
+        if (! impl->memory.empty())
+            impl->applySettings((size_t)voice, false);
+    }
+
+    void EchoBank::processFrames(float* frames, int numSamples)
+    {
+        jassert(! impl->memory.empty());
+
+        if (impl->memory.empty() || numSamples <= 0)
+            return;
+
+        juce::ScopedNoDenormals noDenormals;
+        impl->kernels->processBank(impl->bank, frames, (size_t)numSamples);
+    }
+
+    void EchoBank::process(float* const* channels, int numSamples)
+    {
+        auto& bank = *impl;
+
+        if (bank.memory.empty())
+        {
+            jassertfalse;
+            return;
+        }
+
+        for (auto start = 0; start < numSamples;)
+        {
+            const auto numToProcess = juce::jmin(numSamples - start, (int)bank.ioCapacity);
+
+            for (size_t lane = 0; lane < bank.numLanes; ++lane)
+                for (auto i = 0; i < numToProcess; ++i)
+                    bank.ioFrames[(size_t)i * bank.stride + lane] = channels[lane][start + i];
+
+            processFrames(bank.ioFrames, numToProcess);
+
+            for (size_t lane = 0; lane < bank.numLanes; ++lane)
+                for (auto i = 0; i < numToProcess; ++i)
+                    channels[lane][start + i] = bank.ioFrames[(size_t)i * bank.stride + lane];
+
+            start += numToProcess;
+        }
+    }
+}
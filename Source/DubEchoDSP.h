@@ -0,0 +1,87 @@
+#pragma once
+#include <memory>
+
+//==============================================================================
+// Plain C++ interface to DubEcho's DSP, for engines that embed it directly instead of
+// hosting the plugin. Nothing here depends on JUCE; link against the DubEchoDSP static
+// library built from DubEchoDSP.jucer.
+//
+// prepare may allocate. reset, the setters and process don't, and are meant to be
+// called from the processing thread.
+namespace dubecho
+{
+    constexpr float maxDelayTime = 2.f;
+
+    struct EchoSettings
+    {
+        float delayTime = 0.5f;         // seconds, up to maxDelayTime
+        float delayFeedback = 0.5f;     // 0 to 1
+        float delayWet = 0.5f;          // 0 to 1
+        float reverbSize = 0.5f;        // 0 to 1
+        float reverbDamping = 0.5f;     // 0 to 1
+        float reverbWet = 0.5f;         // 0 to 1
+    };
+
+    //==============================================================================
+    // The plugin's reverb followed by its delay, for one mono or stereo channel
+    class EchoChain
+    {
+    public:
+        explicit EchoChain(int numChannels);
+        ~EchoChain();
+
+        void prepare(double sampleRate, int maximumBlockSize);
+        void reset();
+        void setSettings(const EchoSettings& newSettings);
+
+        // Processes numChannels arrays of numSamples in place
+        void process(float* const* channels, int numSamples);
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> impl;
+    };
+
+    //==============================================================================
+    // EchoChain for many independent voices at once, such as a mixer's sends. Every
+    // channel of every voice is a lane, and the whole bank is stepped one sample at a
+    // time with each stage running across all lanes as plain vector loops. The reverb
+    // is the plugin's (juce::Reverb's mono path) with every lane's combs and allpasses
+    // the same length, so apart from the delay taps nothing is gathered per lane.
+    //
+    // It sounds like EchoChain with one difference: the feedback saturator is the
+    // rational tanh approximation the plugin's economy tier uses, within a fraction
+    // of a dB of tanh, because tanh itself doesn't vectorise. All the state lives in
+    // one allocation made by prepare.
+    class EchoBank
+    {
+    public:
+        EchoBank(int numVoices, int numChannelsPerVoice);
+        ~EchoBank();
+
+        int getNumVoices() const noexcept;
+        int getNumChannelsPerVoice() const noexcept;
+
+        // Floats between the starts of consecutive frames for processFrames, which is
+        // the number of lanes rounded up to a whole number of vectors
+        int getFrameStride() const noexcept;
+
+        void prepare(double sampleRate, int maximumBlockSize);
+        void reset();
+        void setVoiceSettings(int voice, const EchoSettings& newSettings);
+
+        // channels[voice * numChannelsPerVoice + channel] holds numSamples samples,
+        // processed in place. They are transposed into frames and back, which
+        // processFrames avoids for engines that keep their sends interleaved.
+        void process(float* const* channels, int numSamples);
+
+        // frames holds numSamples frames of getFrameStride() floats, lane
+        // voice * numChannelsPerVoice + channel in each, processed in place. The
+        // padding lanes at the end of each frame are overwritten.
+        void processFrames(float* frames, int numSamples);
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> impl;
+    };
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <JuceHeader.h>
+
+//==============================================================================
+// Attack/release envelope follower on a key signal, turned into the gain the echoes
+// are ducked by. Picking the attack or release coefficient is a select rather than a
+// branch, so it runs inline with the wet gain multiply at the same cost whichever
+// way the key is moving.
+template <typename Type>
+class Ducker
+{
+public:
+    //==============================================================================
+    void prepare(double newSampleRate) noexcept
+    {
+        sampleRate = (Type)newSampleRate;
+        updateCoefficients();
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        envelope = Type(0);
+    }
+
+    //==============================================================================
+    // Largest share of the wet signal taken away, 0 to turn ducking off
+    void setAmount(Type newValue) noexcept
+    {
+        jassert(newValue >= Type(0) && newValue <= Type(1));
+        amount = newValue;
+    }
+
+    void setReleaseTime(Type newValue) noexcept
+    {
+        jassert(newValue > Type(0));
+
+        if (newValue != releaseTime)
+        {
+            releaseTime = newValue;
+            updateCoefficients();
+        }
+    }
+
+    bool isActive() const noexcept
+    {
+        return amount > Type(0);
+    }
+
+    //==============================================================================
+    Type processSample(Type key) noexcept
+    {
+        auto level = std::abs(key);
+        auto coefficient = level > envelope ? attackCoefficient : releaseCoefficient;
+        envelope += coefficient * (level - envelope);
+
+        return Type(1) - amount * juce::jmin(Type(1), envelope * inverseThreshold);
+    }
+
+private:
+    // The key level at which the full amount is taken off, about -12 dBFS
+    static constexpr Type inverseThreshold{ Type(4) };
+    static constexpr Type attackTime{ Type(0.005) };
+
+    Type sampleRate{ Type(44.1e3) };
+    Type releaseTime{ Type(0.25) };
+    Type amount{ Type(0) };
+    Type envelope{ Type(0) };
+    Type attackCoefficient{ Type(1) }, releaseCoefficient{ Type(1) };
+
+    void updateCoefficients() noexcept
+    {
+        attackCoefficient = Type(1) - std::exp(Type(-1) / (attackTime * sampleRate));
+        releaseCoefficient = Type(1) - std::exp(Type(-1) / (releaseTime * sampleRate));
+    }
+};
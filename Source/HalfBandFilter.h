@@ -0,0 +1,324 @@
+#pragma once
+#include <JuceHeader.h>
+
+//==============================================================================
+// Polyphase half-band IIR filters for changing the sample rate by a factor of two,
+// after Laurent de Soras' HIIR. The filter is split into two chains of first-order
+// allpass sections in z^-2 that both run at the lower rate, so each coefficient
+// costs one multiply and two adds per low-rate sample, in either direction.
+namespace HalfBand
+{
+    // Coefficients from HIIR's elliptic design. Steep is the one next to the base
+    // rate: flat to 0.46 of the low rate and at least 99 dB down from 0.54. Wide only
+    // has to pass what Steep already band-limited: flat to 0.25 of the low rate and at
+    // least 89 dB down from 0.75.
+    struct Steep
+    {
+        static constexpr size_t numCoefficients = 8;
+        static constexpr std::array<double, numCoefficients> coefficients{
+            0.04063346092419326, 0.1505051290226746, 0.30075705599187408, 0.46077450496145061,
+            0.6095243148961883, 0.73850384111885725, 0.84922381039206607, 0.9497427837050002 };
+    };
+
+    struct Wide
+    {
+        static constexpr size_t numCoefficients = 3;
+        static constexpr std::array<double, numCoefficients> coefficients{
+            0.070224059253204046, 0.28508628044441719, 0.68454135892358636 };
+    };
+
+    //==============================================================================
+    // The allpass chains shared by both directions. Even coefficients make up one
+    // path and odd ones the other.
+    template <typename Type, typename Design>
+    class AllpassPaths
+    {
+    public:
+        void reset() noexcept
+        {
+            inputs.fill(Type(0));
+            outputs.fill(Type(0));
+        }
+
+    protected:
+        void process(Type& even, Type& odd) noexcept
+        {
+            for (size_t i = 0; i < Design::numCoefficients; ++i)
+            {
+                auto& sample = i % 2 == 0 ? even : odd;
+                auto output = (sample - outputs[i]) * Type(Design::coefficients[i]) + inputs[i];
+                inputs[i] = sample;
+                outputs[i] = output;
+                sample = output;
+            }
+        }
+
+    private:
+        std::array<Type, Design::numCoefficients> inputs{}, outputs{};
+    };
+
+    // One sample in, two out at twice the rate
+    template <typename Type, typename Design>
+    class Upsampler : public AllpassPaths<Type, Design>
+    {
+    public:
+        void processSample(Type input, Type& first, Type& second) noexcept
+        {
+            first = second = input;
+            this->process(first, second);
+        }
+    };
+
+    // Two samples in, one out at half the rate
+    template <typename Type, typename Design>
+    class Downsampler : public AllpassPaths<Type, Design>
+    {
+    public:
+        Type processSample(Type first, Type second) noexcept
+        {
+            this->process(second, first);
+            return Type(0.5) * (first + second);
+        }
+    };
+}
+
+//==============================================================================
+// Runs a waveshaper at 1x, 2x or 4x the sample rate one sample at a time, so it can
+// sit inside a feedback loop. Per base-rate sample it costs, counting allpass
+// sections as above and calls to the shaper:
+//
+//   1x:  0 sections, 1 shaper call
+//   2x: 16 sections, 2 shaper calls
+//   4x: 28 sections, 4 shaper calls
+//
+// and twice that for the fadeLength samples after the factor changes, while the old
+// and new factors run side by side and are crossfaded. The lower factors are padded
+// to the 4x latency, so low frequencies are always delayed by getLatency() samples,
+// rounded, and changing the factor while audio runs neither clicks nor moves echoes.
+template <typename Type>
+class OversampledSaturator
+{
+public:
+    static constexpr int fadeLength = 256;
+
+    void setFactor(int newFactor) noexcept
+    {
+        jassert(newFactor == 1 || newFactor == 2 || newFactor == 4);
+        targetFactor = newFactor;
+
+        if (fadeSamplesLeft == 0)
+            startFade();
+    }
+
+    int getFactor() const noexcept
+    {
+        return targetFactor;
+    }
+
+    static constexpr int getLatency() noexcept
+    {
+        return maxLatency;
+    }
+
+    void reset() noexcept
+    {
+        for (auto& path : paths)
+            path.reset();
+
+        paths[active].setFactor(targetFactor);
+        fadeSamplesLeft = 0;
+    }
+
+    template <typename Shaper>
+    Type processSample(Type input, Shaper&& shaper) noexcept
+    {
+        auto output = paths[active].processSample(input, shaper);
+
+        if (fadeSamplesLeft == 0)
+            return output;
+
+        // The outgoing path is the other one until the fade ends
+        auto fading = paths[1 - active].processSample(input, shaper);
+        auto t = Type(fadeSamplesLeft) / Type(fadeLength);
+        output += t * (fading - output);
+
+        if (--fadeSamplesLeft == 0)
+            startFade();
+
+        return output;
+    }
+
+private:
+    static constexpr int maxLatency = 4;
+
+    // One factor's filters, with its output delayed up to the 4x latency
+    class Path
+    {
+    public:
+        void setFactor(int newFactor) noexcept
+        {
+            factor = newFactor;
+            padLength = (size_t)(maxLatency - (factor == 4 ? 4 : (factor == 2 ? 3 : 0)));
+            reset();
+        }
+
+        int getFactor() const noexcept
+        {
+            return factor;
+        }
+
+        void reset() noexcept
+        {
+            steepUp.reset();
+            steepDown.reset();
+            wideUp.reset();
+            wideDown.reset();
+            pad.fill(Type(0));
+            padIndex = 0;
+        }
+
+        template <typename Shaper>
+        Type processSample(Type input, Shaper&& shaper) noexcept
+        {
+            auto output = oversample(input, shaper);
+
+            if (padLength == 0)
+                return output;
+
+            std::swap(output, pad[padIndex]);
+            padIndex = padIndex + 1 == padLength ? 0 : padIndex + 1;
+            return output;
+        }
+
+    private:
+        int factor{ 1 };
+        size_t padLength{ (size_t)maxLatency }, padIndex{ 0 };
+        std::array<Type, (size_t)maxLatency> pad{};
+        HalfBand::Upsampler<Type, HalfBand::Steep> steepUp;
+        HalfBand::Downsampler<Type, HalfBand::Steep> steepDown;
+        HalfBand::Upsampler<Type, HalfBand::Wide> wideUp;
+        HalfBand::Downsampler<Type, HalfBand::Wide> wideDown;
+
+        template <typename Shaper>
+        Type oversample(Type input, Shaper&& shaper) noexcept
+        {
+            if (factor == 1)
+                return shaper(input);
+
+            Type first, second;
+            steepUp.processSample(input, first, second);
+
+            if (factor == 2)
+                return steepDown.processSample(shaper(first), shaper(second));
+
+            std::array<Type, 4> samples;
+            wideUp.processSample(first, samples[0], samples[1]);
+            wideUp.processSample(second, samples[2], samples[3]);
+
+            for (auto& sample : samples)
+                sample = shaper(sample);
+
+            first = wideDown.processSample(samples[0], samples[1]);
+            second = wideDown.processSample(samples[2], samples[3]);
+            return steepDown.processSample(first, second);
+        }
+    };
+
+    // Starts fading to the requested factor from a fresh path, unless it is already
+    // the one playing. A change asked for mid-fade waits for the fade to end.
+    void startFade() noexcept
+    {
+        if (paths[active].getFactor() == targetFactor)
+            return;
+
+        active = 1 - active;
+        paths[active].setFactor(targetFactor);
+        fadeSamplesLeft = fadeLength;
+    }
+
+    std::array<Path, 2> paths;
+    size_t active{ 0 };
+    int targetFactor{ 1 };
+    int fadeSamplesLeft{ 0 };
+};
+
+//==============================================================================
+// Takes a signal down to 1/2 or 1/4 of its rate and back up, so part of a chain can
+// run at the reduced rate. downsample takes getFactor() full-rate samples and returns
+// one; upsample takes one and writes getFactor(). The steep stage sits next to the
+// reduced rate, so everything up to 0.46 of that rate passes and the rest is gone.
+template <typename Type>
+class RateReducer
+{
+public:
+    void setFactor(int newFactor) noexcept
+    {
+        jassert(newFactor == 1 || newFactor == 2 || newFactor == 4);
+
+        if (newFactor != factor)
+        {
+            factor = newFactor;
+            reset();
+        }
+    }
+
+    int getFactor() const noexcept
+    {
+        return factor;
+    }
+
+    // Low-frequency delay of a round trip in full-rate samples, measured, counting the
+    // wait for a whole group of input samples
+    int getLatency() const noexcept
+    {
+        return factor == 4 ? 20 : (factor == 2 ? 8 : 0);
+    }
+
+    void reset() noexcept
+    {
+        steepUp.reset();
+        steepDown.reset();
+        wideUp.reset();
+        wideDown.reset();
+    }
+
+    Type downsample(const Type* input) noexcept
+    {
+        if (factor == 1)
+            return input[0];
+
+        if (factor == 2)
+            return steepDown.processSample(input[0], input[1]);
+
+        auto first = wideDown.processSample(input[0], input[1]);
+        auto second = wideDown.processSample(input[2], input[3]);
+        return steepDown.processSample(first, second);
+    }
+
+    void upsample(Type input, Type* output) noexcept
+    {
+        if (factor == 1)
+        {
+            output[0] = input;
+            return;
+        }
+
+        if (factor == 2)
+        {
+            steepUp.processSample(input, output[0], output[1]);
+            return;
+        }
+
+        Type first, second;
+        steepUp.processSample(input, first, second);
+        wideUp.processSample(first, output[0], output[1]);
+        wideUp.processSample(second, output[2], output[3]);
+    }
+
+private:
+    int factor{ 1 };
+    HalfBand::Upsampler<Type, HalfBand::Steep> steepUp;
+    HalfBand::Downsampler<Type, HalfBand::Steep> steepDown;
+    HalfBand::Upsampler<Type, HalfBand::Wide> wideUp;
+    HalfBand::Downsampler<Type, HalfBand::Wide> wideDown;
+};
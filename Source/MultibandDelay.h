@@ -0,0 +1,444 @@
+#pragma once
+#include <JuceHeader.h>
+#include "Ducker.h"
+#include "SimdKernels.h"
+
+//==============================================================================
+// Mono delay that splits its input into up to maxNumBands bands with Linkwitz-Riley
+// crossovers and gives each band its own feedback, delay offset and saturation drive.
+// The bands travel through the feedback loop side by side as the lanes of the
+// SimdKernels multiband kernel, so running four bands costs about the same as one.
+template <typename Type, size_t maxNumBands = 4>
+class MultibandDelay
+{
+public:
+    static constexpr size_t numLanes = SimdKernels::multibandLanes;
+    static_assert(maxNumBands >= 2 && maxNumBands <= numLanes, "Every band needs a kernel lane");
+    static constexpr Type maxBandOffset{ Type(0.25) };
+
+    //==============================================================================
+    MultibandDelay()
+    {
+        // Lanes past maxNumBands are never used but still go through the arithmetic
+        for (size_t lane = 0; lane < numLanes; ++lane)
+        {
+            kernelState.feedbacks[lane] = Type(0);
+            kernelState.drives[lane] = Type(1);
+            kernelState.inverseDrives[lane] = Type(1);
+        }
+
+        for (size_t band = 0; band < maxNumBands; ++band)
+        {
+            setBandFeedback(band, Type(0.5));
+            setBandOffset(band, Type(0));
+            setBandDrive(band, Type(1));
+        }
+
+        setMaxDelayTime(Type(2.1));
+        setDelayTime(Type(0.5));
+        setWetLevel(Type(0.5));
+        setNumBands(2);
+    }
+
+    ~MultibandDelay()
+    {
+        delete pendingLine.load();
+    }
+
+    //==============================================================================
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        jassert(spec.numChannels == 1);
+        sampleRate = (Type)spec.sampleRate;
+        isPrepared = true;
+        kernels = &SimdKernels::getKernels();
+
+        for (auto& crossover : crossovers)
+            crossover.prepare(spec);
+
+        updateLine();
+        updateCrossovers();
+        updateDelayTimes();
+        ducker.prepare(spec.sampleRate);
+
+        freezeTarget = false;
+        freezeGain.reset(spec.sampleRate, freezeFadeSeconds);
+        freezeGain.setCurrentAndTargetValue(Type(0));
+    }
+
+    //==============================================================================
+    void reset() noexcept
+    {
+        for (auto& crossover : crossovers)
+            crossover.reset();
+
+        if (line != nullptr)
+            std::fill(line->begin(), line->end(), Type(0));
+
+        ducker.reset();
+    }
+
+    //==============================================================================
+    // The line holds a frame of every band per sample of delay, which is several MB,
+    // so it is only built once the multiband mode is first wanted. allocateLine builds
+    // it off the audio thread, like prepare, and acquireLine hands it to the audio
+    // thread. Until then the delay has nothing to run and must stay bypassed.
+    //
+    // Only the audio thread touches line once it is processing. The other side only
+    // reads lineAllocated and writes pendingLine, and prepare, which may rebuild line
+    // directly, is never called while processing.
+    void allocateLine()
+    {
+        if (isPrepared && ! lineAllocated.exchange(true))
+            pendingLine.store(makeLine().release());
+    }
+
+    // True once the line is there to process with. Called on the audio thread.
+    bool acquireLine() noexcept
+    {
+        if (line == nullptr)
+        {
+            if (auto* newLine = pendingLine.exchange(nullptr))
+            {
+                line.reset(newLine);
+                useLine();
+            }
+        }
+
+        return line != nullptr;
+    }
+
+    //==============================================================================
+    void setMaxDelayTime(Type newValue)
+    {
+        jassert(newValue > Type(0));
+        maxDelayTime = newValue;
+        updateLine();
+    }
+
+    void setDelayTime(Type newValue) noexcept
+    {
+        jassert(newValue >= Type(0));
+        delayTime = newValue;
+        updateDelayTimes();
+    }
+
+    void setWetLevel(Type newValue) noexcept
+    {
+        jassert(newValue >= Type(0) && newValue <= Type(1));
+        wetLevel = newValue;
+    }
+
+    void setNumBands(size_t newValue) noexcept
+    {
+        jassert(newValue >= 2 && newValue <= maxNumBands);
+        newValue = juce::jlimit((size_t)2, maxNumBands, newValue);
+
+        if (newValue != numBands)
+        {
+            numBands = newValue;
+            updateCrossovers();
+        }
+    }
+
+    //==============================================================================
+    void setBandFeedback(size_t band, Type newValue) noexcept
+    {
+        jassert(band < maxNumBands);
+        jassert(newValue >= Type(0) && newValue <= Type(1));
+        kernelState.feedbacks[band] = newValue;
+    }
+
+    // Offset in seconds added to the main delay time for this band
+    void setBandOffset(size_t band, Type newValue) noexcept
+    {
+        jassert(band < maxNumBands);
+        jassert(std::abs(newValue) <= maxBandOffset);
+        bandOffsets[band] = newValue;
+        updateDelayTimes();
+    }
+
+    // Gain into the band's saturator, undone after it so only the amount of
+    // saturation changes, not the level
+    void setBandDrive(size_t band, Type newValue) noexcept
+    {
+        jassert(band < maxNumBands);
+        jassert(newValue >= Type(1));
+        kernelState.drives[band] = newValue;
+        kernelState.inverseDrives[band] = Type(1) / newValue;
+    }
+
+    //==============================================================================
+    // Optional block that receives the wet signal on its own, for a stem output.
+    // An empty block stops it being written.
+    void setWetOutput(const juce::dsp::AudioBlock<Type>& newWetOutput) noexcept
+    {
+        wetOutput = newWetOutput;
+    }
+
+    // Same as Delay::setDucking and Delay::setDuckingKey
+    void setDucking(Type amount, Type releaseTime) noexcept
+    {
+        ducker.setAmount(amount);
+        ducker.setReleaseTime(releaseTime);
+    }
+
+    void setDuckingKey(const juce::dsp::AudioBlock<Type>& newKey) noexcept
+    {
+        duckingKey = newKey;
+    }
+
+    //==============================================================================
+    // Same as Delay::setFreeze, with every band looping its own delay time's worth of
+    // the line, so the bands keep their offsets against each other
+    void setFreeze(bool shouldFreeze) noexcept
+    {
+        if (shouldFreeze == freezeTarget)
+            return;
+
+        freezeTarget = shouldFreeze;
+
+        // Re-engaging while the previous loops are still fading out keeps those loops
+        if (shouldFreeze && freezeGain.getCurrentValue() == Type(0))
+            captureFrozenLoops();
+
+        freezeGain.setTargetValue(shouldFreeze ? Type(1) : Type(0));
+    }
+
+    //==============================================================================
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        auto& inputBlock = context.getInputBlock();
+        auto& outputBlock = context.getOutputBlock();
+        auto numSamples = outputBlock.getNumSamples();
+
+        jassert(inputBlock.getNumSamples() == numSamples);
+        jassert(outputBlock.getNumChannels() == 1);
+
+        jassert(context.isBypassed || line != nullptr);
+
+        if (context.isBypassed || line == nullptr)
+        {
+            if (context.usesSeparateInputAndOutputBlocks())
+                outputBlock.copyFrom(inputBlock);
+
+            return;
+        }
+
+        auto* input = inputBlock.getChannelPointer(0);
+        auto* output = outputBlock.getChannelPointer(0);
+        auto* wetOut = wetOutput.getNumChannels() > 0 ? wetOutput.getChannelPointer(0) : nullptr;
+        auto* key = duckingKey.getNumChannels() > 0 ? duckingKey.getChannelPointer(0) : input;
+        auto isDucking = ducker.isActive();
+
+        kernelState.frames = line->data();
+        kernelState.bandInputs = bandInputs.data();
+        kernelState.wet = wetSamples.data();
+
+        // The crossovers and the ducker stay here; the loop between them is the
+        // kernel, run a chunk of samples at a time
+        for (size_t start = 0; start < numSamples; start += chunkSize)
+        {
+            const auto numToProcess = juce::jmin(chunkSize, numSamples - start);
+
+            // Split into bands, with the lanes of unused bands at zero
+            for (size_t i = 0; i < numToProcess; ++i)
+            {
+                auto* frame = bandInputs.data() + i * numLanes;
+                auto remainder = input[start + i];
+
+                for (size_t band = 0; band + 1 < numBands; ++band)
+                    crossovers[band].processSample(0, remainder, frame[band], remainder);
+
+                frame[numBands - 1] = remainder;
+
+                for (size_t lane = numBands; lane < numLanes; ++lane)
+                    frame[lane] = Type(0);
+            }
+
+            // Once fully frozen the line is left alone and only the loops play
+            const auto isFreezing = freezeTarget || freezeGain.getCurrentValue() > Type(0);
+
+            if (freezeTarget && ! freezeGain.isSmoothing())
+                std::fill(wetSamples.begin(), wetSamples.begin() + (std::ptrdiff_t)numToProcess, Type(0));
+            else
+                SimdKernels::processMultiband(*kernels, kernelState, numToProcess);
+
+            for (size_t i = 0; i < numToProcess; ++i)
+            {
+                const auto n = start + i;
+                auto delayedSample = wetSamples[i];
+
+                if (isFreezing)
+                {
+                    auto frozen = freezeGain.getNextValue();
+                    delayedSample += frozen * (readFrozenLoops() - delayedSample);
+                }
+
+                auto wetGain = isDucking ? wetLevel * ducker.processSample(key[n]) : wetLevel;
+                auto wetSample = wetGain * delayedSample;
+                output[n] = input[n] + wetSample;
+
+                if (wetOut != nullptr)
+                    wetOut[n] = wetSample;
+            }
+        }
+    }
+
+private:
+    static constexpr size_t chunkSize = 64;
+
+    std::unique_ptr<std::vector<Type>> line;
+    std::atomic<std::vector<Type>*> pendingLine{ nullptr };
+    std::atomic<bool> lineAllocated{ false };
+    SimdKernels::MultibandState<Type> kernelState{};
+    const SimdKernels::Table* kernels{ nullptr };
+    std::array<Type, chunkSize * numLanes> bandInputs{};
+    std::array<Type, chunkSize> wetSamples{};
+
+    std::array<juce::dsp::LinkwitzRileyFilter<Type>, maxNumBands - 1> crossovers;
+    std::array<Type, maxNumBands> bandOffsets{};
+
+    juce::dsp::AudioBlock<Type> wetOutput, duckingKey;
+    Ducker<Type> ducker;
+    size_t numBands{ 0 };
+    Type delayTime{ Type(0) };
+    Type wetLevel{ Type(0) };
+
+    Type sampleRate{ Type(44.1e3) };
+    Type maxDelayTime{ Type(2) };
+    bool isPrepared{ false };
+
+    // Each band's loop while frozen, as in Delay: length frames counted back from the
+    // anchor, which was the newest frame when the freeze engaged
+    struct FrozenLoop
+    {
+        size_t anchor{ 0 }, length{ 1 }, position{ 0 }, seamLength{ 0 };
+    };
+
+    static constexpr Type freezeFadeSeconds{ Type(0.02) };
+    static constexpr Type maxSeamSeconds{ Type(0.01) };
+    bool freezeTarget{ false };
+    juce::LinearSmoothedValue<Type> freezeGain;
+    std::array<FrozenLoop, maxNumBands> frozenLoops;
+
+    //==============================================================================
+    // Frequencies the bands are split at, for each band count
+    static const std::array<Type, maxNumBands - 1>& getCrossoverFrequencies(size_t bands) noexcept
+    {
+        static const std::array<Type, maxNumBands - 1> twoBands{ Type(1000) },
+                                                       threeBands{ Type(400), Type(3000) },
+                                                       fourBands{ Type(250), Type(1500), Type(6000) };
+
+        return bands <= 2 ? twoBands : (bands == 3 ? threeBands : fourBands);
+    }
+
+    void updateCrossovers()
+    {
+        const auto& frequencies = getCrossoverFrequencies(numBands);
+
+        for (size_t c = 0; c + 1 < numBands; ++c)
+            crossovers[c].setCutoffFrequency(frequencies[c]);
+
+        for (size_t lane = 0; lane < numLanes; ++lane)
+            kernelState.enables[lane] = lane < numBands ? Type(1) : Type(0);
+    }
+
+    // Only allocated once the sample rate is known, like Delay
+    std::unique_ptr<std::vector<Type>> makeLine() const
+    {
+        jassert(isPrepared);
+        auto lineLength = (size_t)std::ceil((maxDelayTime + maxBandOffset) * sampleRate) + 1;
+        return std::make_unique<std::vector<Type>>(lineLength * numLanes, Type(0));
+    }
+
+    // Rebuilds a line that has already been asked for at the new size, from prepare
+    // and setMaxDelayTime, which never run alongside process
+    void updateLine()
+    {
+        if (! isPrepared || ! lineAllocated.load())
+            return;
+
+        delete pendingLine.exchange(nullptr);
+        line = makeLine();
+        useLine();
+    }
+
+    //==============================================================================
+    // The frame offset frames before newest, for one band
+    Type getFrame(size_t newest, size_t offset, size_t band) const noexcept
+    {
+        const auto lineLength = kernelState.lineLength;
+        auto index = newest + lineLength - offset;
+        index -= index >= lineLength ? lineLength : 0;
+        return (*line)[index * numLanes + band];
+    }
+
+    void captureFrozenLoops() noexcept
+    {
+        if (line == nullptr)
+            return;
+
+        // The line keeps being written while the freeze fades in and out, which eats
+        // into the oldest frames, so the seams only use what is left beyond that
+        const auto lineLength = kernelState.lineLength;
+        const auto newest = (kernelState.writeIndex == 0 ? lineLength : kernelState.writeIndex) - 1;
+        const auto fadeSamples = (size_t)juce::roundToInt(freezeFadeSeconds * sampleRate);
+        const auto maxSeam = (size_t)juce::roundToInt(maxSeamSeconds * sampleRate);
+
+        for (size_t band = 0; band < maxNumBands; ++band)
+        {
+            auto& loop = frozenLoops[band];
+            loop.anchor = newest;
+            loop.length = juce::jmin(kernelState.delaySamples[band], lineLength - 1);
+            loop.position = 0;
+
+            const auto spare = lineLength > loop.length + 2 * fadeSamples ? lineLength - loop.length - 2 * fadeSamples : 0;
+            loop.seamLength = juce::jmin(juce::jmin(loop.length / 4, maxSeam), spare);
+        }
+    }
+
+    // The sum of the bands' loops, each read like Delay::readFrozenLoop
+    Type readFrozenLoops() noexcept
+    {
+        auto sum = Type(0);
+
+        for (size_t band = 0; band < numBands; ++band)
+        {
+            auto& loop = frozenLoops[band];
+            auto offset = loop.length - 1 - loop.position;
+            auto sample = getFrame(loop.anchor, offset, band);
+            auto seamStart = loop.length - loop.seamLength;
+
+            if (loop.position >= seamStart)
+            {
+                auto t = Type(loop.position - seamStart + 1) / Type(loop.seamLength + 1);
+                sample += t * (getFrame(loop.anchor, offset + loop.length, band) - sample);
+            }
+
+            loop.position = loop.position + 1 == loop.length ? 0 : loop.position + 1;
+            sum += sample;
+        }
+
+        return sum;
+    }
+
+    void useLine() noexcept
+    {
+        kernelState.lineLength = line->size() / numLanes;
+        kernelState.writeIndex = 0;
+        updateDelayTimes();
+    }
+
+    void updateDelayTimes() noexcept
+    {
+        const auto lineLength = kernelState.lineLength;
+
+        for (size_t band = 0; band < maxNumBands; ++band)
+        {
+            auto samples = (size_t)juce::roundToInt(juce::jmax(Type(0), delayTime + bandOffsets[band]) * sampleRate);
+            kernelState.delaySamples[band] = juce::jlimit((size_t)1, juce::jmax((size_t)1, lineLength - 1), samples);
+        }
+    }
+};
@@ -25,9 +25,30 @@ DubEchoAudioProcessorEditor::DubEchoAudioProcessorEditor (DubEchoAudioProcessor&
     reverbSizeSliderAttachment(audioProcessor.apvts, "Reverb Size", reverbSizeSlider),
     reverbDampingSliderAttachment(audioProcessor.apvts, "Reverb Damping", reverbDampingSlider),
     reverbWetSliderAttachment(audioProcessor.apvts, "Reverb Dry/Wet", reverbWetSlider),
+    qualityLockAttachment(audioProcessor.apvts, "Quality Lock", qualityLockButton),
+    delayFreezeAttachment(audioProcessor.apvts, "Delay Freeze", delayFreezeButton),
+    reverbFreezeAttachment(audioProcessor.apvts, "Reverb Freeze", reverbFreezeButton),
+
+    duckAmountSlider(*audioProcessor.apvts.getParameter("Duck Amount"), ""),
+    duckReleaseSlider(*audioProcessor.apvts.getParameter("Duck Release"), ""),
+    duckSourceSlider(*audioProcessor.apvts.getParameter("Duck Source"), ""),
+    oversamplingSlider(*audioProcessor.apvts.getParameter("Saturation Oversampling"), ""),
+
+    duckAmountSliderAttachment(audioProcessor.apvts, "Duck Amount", duckAmountSlider),
+    duckReleaseSliderAttachment(audioProcessor.apvts, "Duck Release", duckReleaseSlider),
+    duckSourceSliderAttachment(audioProcessor.apvts, "Duck Source", duckSourceSlider),
+    oversamplingSliderAttachment(audioProcessor.apvts, "Saturation Oversampling", oversamplingSlider),
+
+    delayBandsSlider(*audioProcessor.apvts.getParameter("Delay Bands"), ""),
+    bandFeedBackSlider(*audioProcessor.apvts.getParameter("Band 1 Feedback"), ""),
+    bandOffsetSlider(*audioProcessor.apvts.getParameter("Band 1 Offset"), ""),
+    bandDriveSlider(*audioProcessor.apvts.getParameter("Band 1 Drive"), ""),
+
+    delayBandsSliderAttachment(audioProcessor.apvts, "Delay Bands", delayBandsSlider),
 
     verticalDiscreteMeterL([&]() { return audioProcessor.getRmsValue(0); }),
-    verticalDiscreteMeterR([&]() { return audioProcessor.getRmsValue(1); })
+    verticalDiscreteMeterR([&]() { return audioProcessor.getRmsValue(1); }),
+    spectrumAnalyser(audioProcessor.getAnalyserFifo())
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
@@ -38,7 +59,25 @@ DubEchoAudioProcessorEditor::DubEchoAudioProcessorEditor (DubEchoAudioProcessor&
     {
         addAndMakeVisible(comp);
     }
-    setSize (400, 300);
+    for (auto* button : { &qualityLockButton, &delayFreezeButton, &reverbFreezeButton })
+    {
+        button->setColour(juce::ToggleButton::textColourId, juce::Colours::black);
+        button->setColour(juce::ToggleButton::tickColourId, juce::Colours::black);
+        button->setColour(juce::ToggleButton::tickDisabledColourId, juce::Colours::darkgrey);
+    }
+    qualityTierLabel.setColour(juce::Label::textColourId, juce::Colours::black);
+    qualityTierLabel.setJustificationType(juce::Justification::centredRight);
+
+    for (auto band = 1; band <= maxNumDelayBands; ++band)
+        bandSelector.addItem("Band " + juce::String(band), band);
+
+    bandSelector.onChange = [this] { attachBand(bandSelector.getSelectedId()); };
+    bandSelector.setSelectedId(1, juce::dontSendNotification);
+    attachBand(1);
+    updateBandControls();
+
+    setSize (400, 668);
+    startTimerHz(4);
 }
 
 DubEchoAudioProcessorEditor::~DubEchoAudioProcessorEditor()
@@ -60,6 +99,15 @@ void DubEchoAudioProcessorEditor::paint (juce::Graphics& g)
     g.drawFittedText("Damping", reverbDampingSlider.getBounds(), juce::Justification::centredBottom, 1);
     g.drawFittedText("Dry/Wet", reverbWetSlider.getBounds(), juce::Justification::centredBottom, 1);
 
+    g.drawFittedText("Duck", duckAmountSlider.getBounds(), juce::Justification::centredBottom, 1);
+    g.drawFittedText("Release", duckReleaseSlider.getBounds(), juce::Justification::centredBottom, 1);
+    g.drawFittedText("Key", duckSourceSlider.getBounds(), juce::Justification::centredBottom, 1);
+    g.drawFittedText("Oversample", oversamplingSlider.getBounds(), juce::Justification::centredBottom, 1);
+
+    g.drawFittedText("Bands", delayBandsSlider.getBounds(), juce::Justification::centredBottom, 1);
+    g.drawFittedText("FeedBack", bandFeedBackSlider.getBounds(), juce::Justification::centredBottom, 1);
+    g.drawFittedText("Offset", bandOffsetSlider.getBounds(), juce::Justification::centredBottom, 1);
+    g.drawFittedText("Drive", bandDriveSlider.getBounds(), juce::Justification::centredBottom, 1);
 }
 
 void DubEchoAudioProcessorEditor::resized()
@@ -70,6 +118,29 @@ void DubEchoAudioProcessorEditor::resized()
 
     auto area = getLocalBounds();
 
+    spectrumAnalyser.setBounds(area.removeFromBottom(120).reduced(border));
+
+    auto freezeArea = area.removeFromBottom(24);
+    delayFreezeButton.setBounds(freezeArea.removeFromLeft(freezeArea.getWidth() / 2).reduced(border, 0));
+    reverbFreezeButton.setBounds(freezeArea.reduced(border, 0));
+
+    auto qualityArea = area.removeFromBottom(24);
+    qualityLockButton.setBounds(qualityArea.removeFromLeft(qualityArea.getWidth() / 2).reduced(border, 0));
+    qualityTierLabel.setBounds(qualityArea.reduced(border, 0));
+
+    auto bandArea = area.removeFromBottom(100);
+    delayBandsSlider.setBounds(bandArea.removeFromLeft(bandArea.getWidth() / 5).reduced(border));
+    bandSelector.setBounds(bandArea.removeFromLeft(bandArea.getWidth() / 4).withSizeKeepingCentre(bandArea.getWidth() / 4, 24).reduced(border, 0));
+    bandFeedBackSlider.setBounds(bandArea.removeFromLeft(bandArea.getWidth() / 3).reduced(border));
+    bandOffsetSlider.setBounds(bandArea.removeFromLeft(bandArea.getWidth() / 2).reduced(border));
+    bandDriveSlider.setBounds(bandArea.reduced(border));
+
+    auto duckArea = area.removeFromBottom(100);
+    duckAmountSlider.setBounds(duckArea.removeFromLeft(duckArea.getWidth() / 4).reduced(border));
+    duckReleaseSlider.setBounds(duckArea.removeFromLeft(duckArea.getWidth() / 3).reduced(border));
+    duckSourceSlider.setBounds(duckArea.removeFromLeft(duckArea.getWidth() / 2).reduced(border));
+    oversamplingSlider.setBounds(duckArea.reduced(border));
+
     auto meterBounds = area.removeFromRight(area.getWidth() / 6);
     verticalDiscreteMeterL.setBounds(meterBounds.removeFromRight(meterBounds.getWidth() / 2).reduced(border));
     verticalDiscreteMeterR.setBounds(meterBounds.reduced(border));
@@ -85,6 +156,46 @@ void DubEchoAudioProcessorEditor::resized()
     reverbWetSlider.setBounds(reverbArea.reduced(border));
 }
 
+void DubEchoAudioProcessorEditor::timerCallback()
+{
+    auto tier = audioProcessor.getQualityTier() == QualityGovernor::high ? "High" : "Economy";
+    qualityTierLabel.setText(juce::String("Quality: ") + tier, juce::dontSendNotification);
+    updateBandControls();
+}
+
+// Points the band sliders at the picked band's parameters. The old attachments go
+// first, so they can't write the new band's values back to the old band.
+void DubEchoAudioProcessorEditor::attachBand(int band)
+{
+    const auto prefix = "Band " + juce::String(juce::jlimit(1, maxNumDelayBands, band));
+
+    bandFeedBackSliderAttachment.reset();
+    bandOffsetSliderAttachment.reset();
+    bandDriveSliderAttachment.reset();
+
+    bandFeedBackSlider.setParameter(*audioProcessor.apvts.getParameter(prefix + " Feedback"));
+    bandOffsetSlider.setParameter(*audioProcessor.apvts.getParameter(prefix + " Offset"));
+    bandDriveSlider.setParameter(*audioProcessor.apvts.getParameter(prefix + " Drive"));
+
+    bandFeedBackSliderAttachment = std::make_unique<Attachment>(audioProcessor.apvts, prefix + " Feedback", bandFeedBackSlider);
+    bandOffsetSliderAttachment = std::make_unique<Attachment>(audioProcessor.apvts, prefix + " Offset", bandOffsetSlider);
+    bandDriveSliderAttachment = std::make_unique<Attachment>(audioProcessor.apvts, prefix + " Drive", bandDriveSlider);
+    updateBandControls();
+}
+
+// The band controls only do anything for the bands the multiband delay is running
+void DubEchoAudioProcessorEditor::updateBandControls()
+{
+    const auto bandChoice = (int)audioProcessor.apvts.getRawParameterValue("Delay Bands")->load();
+    const auto numBands = bandChoice == 0 ? 1 : bandChoice + 1;
+    const auto isBandActive = numBands > 1 && bandSelector.getSelectedId() <= numBands;
+
+    bandSelector.setEnabled(numBands > 1);
+
+    for (auto* slider : { &bandFeedBackSlider, &bandOffsetSlider, &bandDriveSlider })
+        slider->setEnabled(isBandActive);
+}
+
 std::vector<juce::Component*> DubEchoAudioProcessorEditor::getComps()
 {
     return
@@ -97,7 +208,26 @@ std::vector<juce::Component*> DubEchoAudioProcessorEditor::getComps()
         &reverbWetSlider,
 
         &verticalDiscreteMeterL,
-        &verticalDiscreteMeterR
+        &verticalDiscreteMeterR,
+
+        &spectrumAnalyser,
+
+        &qualityLockButton,
+        &qualityTierLabel,
+
+        &delayFreezeButton,
+        &reverbFreezeButton,
+
+        &duckAmountSlider,
+        &duckReleaseSlider,
+        &duckSourceSlider,
+        &oversamplingSlider,
+
+        &delayBandsSlider,
+        &bandSelector,
+        &bandFeedBackSlider,
+        &bandOffsetSlider,
+        &bandDriveSlider
     };
 }
 
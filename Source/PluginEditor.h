@@ -11,6 +11,7 @@
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
 #include "VerticalDiscreteMeter.h"
+#include "SpectrumAnalyser.h"
 
 
 struct LookAndFeel : juce::LookAndFeel_V4
@@ -53,6 +54,9 @@ struct RotarySliderWithLabels : juce::Slider
     int getTextHeight() const { return 14; }
     juce::String getDisplayString() const;
 
+    // For a slider whose attachment moves between parameters
+    void setParameter(juce::RangedAudioParameter& rap) { param = &rap; repaint(); }
+
 private:
     LookAndFeel lnf;
     juce::RangedAudioParameter* param;
@@ -61,7 +65,7 @@ private:
 //==============================================================================
 /**
 */
-class DubEchoAudioProcessorEditor : public juce::AudioProcessorEditor
+class DubEchoAudioProcessorEditor : public juce::AudioProcessorEditor, juce::Timer
 {
 public:
     DubEchoAudioProcessorEditor (DubEchoAudioProcessor&);
@@ -71,6 +75,7 @@ public:
 
     void paint (juce::Graphics&) override;
     void resized() override;
+    void timerCallback() override;
 
 private:
     // This reference is provided as a quick way for your editor to
@@ -94,9 +99,42 @@ private:
         reverbDampingSliderAttachment,
         reverbWetSliderAttachment;
 
+    juce::ToggleButton qualityLockButton{ "Lock Quality" };
+    APVTS::ButtonAttachment qualityLockAttachment;
+    juce::Label qualityTierLabel;
+
+    juce::ToggleButton delayFreezeButton{ "Delay Freeze" }, reverbFreezeButton{ "Reverb Freeze" };
+    APVTS::ButtonAttachment delayFreezeAttachment, reverbFreezeAttachment;
+
+    RotarySliderWithLabels duckAmountSlider,
+        duckReleaseSlider,
+        duckSourceSlider,
+        oversamplingSlider;
+
+    Attachment duckAmountSliderAttachment,
+        duckReleaseSliderAttachment,
+        duckSourceSliderAttachment,
+        oversamplingSliderAttachment;
+
+    // One band's controls at a time, for the band picked in bandSelector
+    RotarySliderWithLabels delayBandsSlider,
+        bandFeedBackSlider,
+        bandOffsetSlider,
+        bandDriveSlider;
+
+    Attachment delayBandsSliderAttachment;
+    std::unique_ptr<Attachment> bandFeedBackSliderAttachment,
+        bandOffsetSliderAttachment,
+        bandDriveSliderAttachment;
+
+    juce::ComboBox bandSelector;
+    void attachBand(int band);
+    void updateBandControls();
+
     std::vector<juce::Component*> getComps();
 
     GUI::VerticalDiscreteMeter verticalDiscreteMeterL, verticalDiscreteMeterR;
+    GUI::SpectrumAnalyser spectrumAnalyser;
     LookAndFeel lnf;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DubEchoAudioProcessorEditor)
 };
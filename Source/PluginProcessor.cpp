@@ -16,16 +16,36 @@ DubEchoAudioProcessor::DubEchoAudioProcessor()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                       .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
+                       .withOutput ("Delay Wet", juce::AudioChannelSet::stereo(), false)
+                       .withOutput ("Reverb Wet", juce::AudioChannelSet::stereo(), false)
                      #endif
                        )
 #endif
 {
+    // Leave some headroom above the longest delay time the parameter allows. The
+    // multiband delay has no line yet, so the single band one starts out playing.
+    auto setUpDelays = [](auto& state)
+    {
+        for (auto* chain : { &state.leftChain, &state.rightChain })
+        {
+            chain->template get<ChainPositions::delay>().setMaxDelayTime(maxDelayTimeSeconds * 1.05f);
+            chain->template get<ChainPositions::multibandDelay>().setMaxDelayTime(maxMultibandDelayTimeSeconds * 1.05f);
+            chain->template setBypassed<ChainPositions::multibandDelay>(true);
+        }
+    };
+
+    setUpDelays(floatState);
+    setUpDelays(doubleState);
+
+    chainParameters = getChainParameters(apvts);
 }
 
 DubEchoAudioProcessor::~DubEchoAudioProcessor()
 {
+    stopTimer();
 }
 
 //==============================================================================
@@ -61,9 +81,51 @@ bool DubEchoAudioProcessor::isMidiEffect() const
    #endif
 }
 
+// How long the output rings on after the input stops, until it is 60 dB down: the
+// reverb's tail, then the echoes of it. Either freeze holds its sound forever.
 double DubEchoAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    const auto settings = getChainSettings(chainParameters);
+
+    if (settings.delayFreeze || settings.reverbFreeze)
+        return std::numeric_limits<double>::infinity();
+
+    // Repeats of one delay time until the echoes are 60 dB down, counting the first
+    auto getEchoTail = [](double time, double feedback)
+    {
+        if (feedback >= maxDecayingFeedback)
+            return std::numeric_limits<double>::infinity();
+
+        const auto repeats = feedback > 0.0 ? std::log(1.0e-3) / std::log(feedback) : 0.0;
+        return time * (1.0 + repeats);
+    };
+
+    auto delayTail = 0.0;
+
+    if (settings.delayWet > 0.f)
+    {
+        if (settings.delayBands > 1)
+        {
+            const auto time = juce::jmin(settings.delayTime, maxMultibandDelayTimeSeconds);
+
+            for (auto band = 0; band < settings.delayBands; ++band)
+                delayTail = juce::jmax(delayTail, getEchoTail(juce::jmax(0.f, time + settings.bandOffset[(size_t)band]),
+                                                              settings.bandFeedBack[(size_t)band]));
+        }
+        else
+        {
+            delayTail = getEchoTail(settings.delayTime, settings.delayFeedBack);
+        }
+    }
+
+    // juce::Reverb's combs feed back roomSize * 0.28 + 0.7 every 1617 samples at
+    // 44.1 kHz at the longest, ignoring the damping, which only shortens the tail
+    auto reverbTail = 0.0;
+
+    if (settings.reverbWet > 0.f)
+        reverbTail = getEchoTail(1617.0 / 44100.0, settings.reverbSize * 0.28 + 0.7);
+
+    return reverbTail + delayTail;
 }
 
 int DubEchoAudioProcessor::getNumPrograms()
@@ -96,26 +158,108 @@ void DubEchoAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBloc
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
 
+    internalBlockSize = getInternalBlockSizeSetting();
+    wetDecimation = getWetDecimationSetting();
+    requestedInternalBlockSize = internalBlockSize;
+    requestedWetDecimation = wetDecimation;
+
     juce::dsp::ProcessSpec spec;
-    spec.maximumBlockSize = samplesPerBlock;
+    spec.maximumBlockSize = internalBlockSize > 0 ? internalBlockSize : samplesPerBlock;
     spec.numChannels = 1;
     spec.sampleRate = sampleRate;
 
+    internalBlockPosition = 0;
+    setLatencySamples(internalBlockSize);
+
+    auto* sidechain = getBus(true, sidechainBus);
+    sidechainEnabled = sidechain != nullptr && sidechain->isEnabled();
+
+    if (isUsingDoublePrecision())
+        prepareChainState<double>(spec);
+    else
+        prepareChainState<float>(spec);
+
+    reverbBuffer.setSize(4, (int)spec.maximumBlockSize);
+
     updateFXChain();
 
+    // Resetting also snaps the gains to the targets updateFXChain just set
+    for (auto& gain : reverbDryGains)
+        gain.reset(sampleRate, 0.01);
+
+    reverbShare.reset(sampleRate, 0.5);
+    reverbShare.setCurrentAndTargetValue(governor.getTier() == QualityGovernor::high ? 0.f : 1.f);
+    rightReverbIdle = false;
+
     rmsLevelLeft.reset(sampleRate, 0.2);
     rmsLevelRight.reset(sampleRate, 0.2);
     rmsLevelLeft.setCurrentAndTargetValue(-100.f);
     rmsLevelRight.setCurrentAndTargetValue(-100.f);
 
-    leftChain.prepare(spec);
-    rightChain.prepare(spec);
+    analyserFifo.setSampleRate(sampleRate);
+    governor.prepare(sampleRate);
+
+    // Loading a session creates every instance before any of them plays, so the
+    // telemetry slot and the timer wait until here. The timer polls the quality
+    // governor so the audio thread never posts messages itself, builds the multiband
+    // lines and watches the setup parameters, none of which matter before this.
+    telemetry.open();
+    startTimerHz(2);
+}
+
+template <typename SampleType>
+void DubEchoAudioProcessor::prepareChainState(const juce::dsp::ProcessSpec& spec)
+{
+    auto& state = getChainState<SampleType>();
+
+    if (internalBlockSize > 0)
+    {
+        state.internalBlockBuffer.setSize(juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels()), internalBlockSize);
+        state.internalBlockBuffer.clear();
+    }
+    else
+    {
+        state.internalBlockBuffer.setSize(0, 0);
+    }
+
+    state.sidechainKeyBuffer.setSize(sidechainEnabled ? 2 : 0, (int)spec.maximumBlockSize);
+    state.sidechainKeyBuffer.clear();
+    state.delayFadeBuffer.setSize(4, (int)spec.maximumBlockSize);
+    state.delayFadeSamplesLeft = 0;
+
+    // Hosts often call prepareToPlay again with unchanged settings, in which case
+    // clearing the existing buffers is enough
+    const auto doublePrecision = std::is_same<SampleType, double>::value;
+
+    if (spec.sampleRate != preparedSampleRate || spec.maximumBlockSize > preparedBlockSize
+     || doublePrecision != preparedDoublePrecision || wetDecimation != preparedWetDecimation)
+    {
+        state.leftChain.template get<ChainPositions::delay>().setWetDecimation(wetDecimation);
+        state.rightChain.template get<ChainPositions::delay>().setWetDecimation(wetDecimation);
+        state.leftChain.prepare(spec);
+        state.rightChain.prepare(spec);
+        preparedSampleRate = spec.sampleRate;
+        preparedBlockSize = spec.maximumBlockSize;
+        preparedDoublePrecision = doublePrecision;
+        preparedWetDecimation = wetDecimation;
+    }
+    else
+    {
+        state.leftChain.reset();
+        state.rightChain.reset();
+    }
+
+    // A session restored with the bands on shouldn't wait for the timer
+    if (getChainSettings(chainParameters).delayBands > 1)
+        allocateMultibandLines(state);
 }
 
 void DubEchoAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    stopTimer();
+    telemetry.close();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -139,14 +283,103 @@ bool DubEchoAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
         return false;
    #endif
 
+    // The sidechain is optional and can be mono or stereo
+    for (auto bus = 1; bus < layouts.inputBuses.size(); ++bus)
+    {
+        const auto& sidechainSet = layouts.inputBuses.getReference(bus);
+
+        if (! sidechainSet.isDisabled()
+         && sidechainSet != juce::AudioChannelSet::mono()
+         && sidechainSet != juce::AudioChannelSet::stereo())
+            return false;
+    }
+
+    // The stem outputs are optional, but when enabled they match the main output
+    for (auto bus = 1; bus < layouts.outputBuses.size(); ++bus)
+    {
+        const auto& stemSet = layouts.outputBuses.getReference(bus);
+
+        if (! stemSet.isDisabled() && stemSet != layouts.getMainOutputChannelSet())
+            return false;
+    }
+
     return true;
   #endif
 }
 #endif
 
 void DubEchoAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process(buffer);
+}
+
+void DubEchoAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    process(buffer);
+}
+
+template <typename SampleType>
+void DubEchoAudioProcessor::process(juce::AudioBuffer<SampleType>& buffer)
 {
     juce::ScopedNoDenormals noDenormals;
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    if (internalBlockSize > 0)
+        processInternalBlocks(buffer);
+    else
+        processChain(buffer);
+
+    governor.endBlock(startTicks, buffer.getNumSamples());
+    publishTelemetry(buffer, startTicks);
+}
+
+template <typename SampleType>
+void DubEchoAudioProcessor::publishTelemetry(const juce::AudioBuffer<SampleType>& buffer, juce::int64 startTicks)
+{
+    if (! telemetry.isActive())
+        return;
+
+    const auto numSamples = buffer.getNumSamples();
+    const auto duration = numSamples / getSampleRate();
+    const auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+    auto& stats = telemetryStats;
+
+    ++stats.blocksProcessed;
+
+    if (elapsed > duration)
+        ++stats.deadlineMisses;
+
+    stats.sampleRate = getSampleRate();
+    stats.blockSize = (uint32_t)numSamples;
+    stats.qualityTier = (uint32_t)governor.getTier();
+    stats.lastBlockLoad = duration > 0.0 ? (float)(elapsed / duration) : 0.f;
+    stats.smoothedLoad = (float)governor.getLoad();
+    stats.rmsLeft = rmsLevelLeft.getCurrentValue();
+    stats.rmsRight = rmsLevelRight.getCurrentValue();
+
+    stats.delayTime = chainParameters.delayTime->load();
+    stats.delayFeedback = chainParameters.delayFeedBack->load();
+    stats.delayWet = chainParameters.delayWet->load();
+    stats.reverbSize = chainParameters.reverbSize->load();
+    stats.reverbDamping = chainParameters.reverbDamping->load();
+    stats.reverbWet = chainParameters.reverbWet->load();
+
+    auto outputMagnitude = SampleType(0);
+
+    for (auto ch = 0; ch < juce::jmin(2, buffer.getNumChannels()); ++ch)
+        outputMagnitude = juce::jmax(outputMagnitude, buffer.getMagnitude(ch, 0, numSamples));
+
+    stats.flags = (isUsingDoublePrecision() ? Telemetry::doublePrecision : 0u)
+                | (chainParameters.delayFreeze->load() > 0.5f ? Telemetry::delayFrozen : 0u)
+                | (chainParameters.reverbFreeze->load() > 0.5f ? Telemetry::reverbFrozen : 0u)
+                | (outputMagnitude < SampleType(1.0e-5) ? Telemetry::outputSilent : 0u);
+
+    telemetry.publish(stats);
+}
+
+template <typename SampleType>
+void DubEchoAudioProcessor::processChain(juce::AudioBuffer<SampleType>& buffer)
+{
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -160,19 +393,225 @@ void DubEchoAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce
         buffer.clear (i, 0, buffer.getNumSamples());
     
     updateFXChain();
-    juce::dsp::AudioBlock<float> block(buffer);
 
-    auto leftBlock = block.getSingleChannelBlock(0);
-    auto rightBlock = block.getSingleChannelBlock(1);
+    auto mainBuffer = getBusBuffer(buffer, false, 0);
+    auto delayWetBuffer = getBusBuffer(buffer, false, delayWetBus);
+    auto reverbWetBuffer = getBusBuffer(buffer, false, reverbWetBus);
+    // The sidechain's channels are shared with the stem outputs in the host buffer, so the
+    // key is copied out before any stage writes there. Without it the delays key off their input.
+    auto& state = getChainState<SampleType>();
+    juce::dsp::AudioBlock<SampleType> keyBlock;
+
+    if (duckFromSidechain)
+    {
+        auto sidechainBuffer = getBusBuffer(buffer, true, sidechainBus);
+        auto& keyBuffer = state.sidechainKeyBuffer;
+        const auto numSamples = buffer.getNumSamples();
 
-    juce::dsp::ProcessContextReplacing<float> leftContext(leftBlock);
-    juce::dsp::ProcessContextReplacing<float> rightContext(rightBlock);
+        for (auto ch = 0; ch < keyBuffer.getNumChannels(); ++ch)
+            keyBuffer.copyFrom(ch, 0, sidechainBuffer, juce::jmin(ch, sidechainBuffer.getNumChannels() - 1), 0, numSamples);
 
+        keyBlock = juce::dsp::AudioBlock<SampleType>(keyBuffer).getSubBlock(0, (size_t)numSamples);
+    }
 
     updateRmsVal(buffer);
 
-    leftChain.process(leftContext);
-    rightChain.process(rightContext);
+    processReverbs(state, mainBuffer, reverbWetBuffer);
+    processMonoChain(state, 0, mainBuffer, delayWetBuffer, keyBlock);
+    processMonoChain(state, 1, mainBuffer, delayWetBuffer, keyBlock);
+    state.delayFadeSamplesLeft = juce::jmax(0, state.delayFadeSamplesLeft - buffer.getNumSamples());
+
+    analyserFifo.push(buffer, buffer.getNumSamples());
+}
+
+// The reverbs run wet only, both channels at once, so the economy tier can share one
+template <typename SampleType>
+void DubEchoAudioProcessor::processReverbs(ChainState<SampleType>& state, juce::AudioBuffer<SampleType>& mainBuffer,
+                                           juce::AudioBuffer<SampleType>& reverbWetBuffer)
+{
+    const auto numSamples = mainBuffer.getNumSamples();
+    const auto numChannels = juce::jmin(2, mainBuffer.getNumChannels());
+    auto& leftReverb = state.leftChain.template get<ChainPositions::reverb>();
+    auto& rightReverb = state.rightChain.template get<ChainPositions::reverb>();
+
+    // juce::dsp::Reverb only comes in float, so the inputs are copied into the first
+    // two channels of reverbBuffer and the wet signals come out in the next two
+    auto reverbBlock = juce::dsp::AudioBlock<float>(reverbBuffer).getSubBlock(0, (size_t)numSamples);
+    std::array<float*, 2> inputs{}, wets{};
+
+    for (auto ch = 0; ch < numChannels; ++ch)
+    {
+        inputs[(size_t)ch] = reverbBlock.getChannelPointer((size_t)ch);
+        wets[(size_t)ch] = reverbBlock.getChannelPointer((size_t)ch + 2);
+
+        const auto* data = mainBuffer.getReadPointer(ch);
+        std::transform(data, data + numSamples, inputs[(size_t)ch], [](SampleType x) { return (float)x; });
+    }
+
+    // In the economy tier the left reverb takes the mid signal and the right channel
+    // uses its output too, so only one reverb runs. The share ramps both ways to keep
+    // the switch quiet, and the idle reverb is cleared so it comes back from silence.
+    const auto canShare = numChannels == 2;
+    const auto shared = canShare && ! reverbShare.isSmoothing() && reverbShare.getTargetValue() == 1.f;
+    const auto crossfading = canShare && reverbShare.isSmoothing();
+    auto rightShare = reverbShare;
+
+    if (crossfading || shared)
+    {
+        auto* left = inputs[0];
+        const auto* right = inputs[1];
+
+        for (auto i = 0; i < numSamples; ++i)
+            left[i] += reverbShare.getNextValue() * 0.5f * (right[i] - left[i]);
+    }
+    else
+    {
+        reverbShare.skip(numSamples);
+    }
+
+    // The context keeps a reference to its output block, so the blocks need names
+    auto leftInput = reverbBlock.getSingleChannelBlock(0);
+    auto leftWet = reverbBlock.getSingleChannelBlock(2);
+    leftReverb.process(juce::dsp::ProcessContextNonReplacing<float>(leftInput, leftWet));
+
+    if (shared)
+    {
+        std::copy(wets[0], wets[0] + numSamples, wets[1]);
+
+        if (! rightReverbIdle)
+        {
+            rightReverb.reset();
+            rightReverbIdle = true;
+        }
+    }
+    else if (numChannels == 2)
+    {
+        rightReverbIdle = false;
+        auto rightInput = reverbBlock.getSingleChannelBlock(1);
+        auto rightWet = reverbBlock.getSingleChannelBlock(3);
+        rightReverb.process(juce::dsp::ProcessContextNonReplacing<float>(rightInput, rightWet));
+
+        if (crossfading)
+            for (auto i = 0; i < numSamples; ++i)
+                wets[1][i] += rightShare.getNextValue() * (wets[0][i] - wets[1][i]);
+    }
+
+    // Then the dry signal is scaled the way the reverb would have scaled it
+    for (auto ch = 0; ch < numChannels; ++ch)
+    {
+        const auto* wet = wets[(size_t)ch];
+        auto* data = mainBuffer.getWritePointer(ch);
+        auto& dryGain = reverbDryGains[(size_t)ch];
+
+        for (auto i = 0; i < numSamples; ++i)
+            data[i] = data[i] * (SampleType)dryGain.getNextValue() + (SampleType)wet[i];
+
+        if (ch < reverbWetBuffer.getNumChannels())
+            std::transform(wet, wet + numSamples, reverbWetBuffer.getWritePointer(ch), [](float x) { return (SampleType)x; });
+    }
+}
+
+template <typename SampleType>
+void DubEchoAudioProcessor::processMonoChain(ChainState<SampleType>& state, int channel, juce::AudioBuffer<SampleType>& mainBuffer,
+                                             juce::AudioBuffer<SampleType>& delayWetBuffer, juce::dsp::AudioBlock<SampleType> keyBlock)
+{
+    // Stem buses that are disabled have no channels and give an empty block
+    auto getChannelBlock = [channel](juce::AudioBuffer<SampleType>& b)
+    {
+        return channel < b.getNumChannels() ? juce::dsp::AudioBlock<SampleType>(b).getSingleChannelBlock((size_t)channel)
+                                            : juce::dsp::AudioBlock<SampleType>();
+    };
+
+    auto& chain = channel == 0 ? state.leftChain : state.rightChain;
+    auto block = getChannelBlock(mainBuffer);
+    auto delayWetBlock = getChannelBlock(delayWetBuffer);
+    const auto numSamples = block.getNumSamples();
+
+    if (keyBlock.getNumChannels() > 0)
+        keyBlock = keyBlock.getSingleChannelBlock((size_t)channel);
+
+    auto processDelay = [&keyBlock](auto& delay, juce::dsp::AudioBlock<SampleType>& delayBlock,
+                                    const juce::dsp::AudioBlock<SampleType>& wetBlock)
+    {
+        delay.setWetOutput(wetBlock);
+        delay.setDuckingKey(keyBlock);
+        delay.process(juce::dsp::ProcessContextReplacing<SampleType>(delayBlock));
+    };
+
+    auto& delay = chain.template get<ChainPositions::delay>();
+    auto& multiband = chain.template get<ChainPositions::multibandDelay>();
+    const auto useMultiband = ! chain.template isBypassed<ChainPositions::multibandDelay>();
+
+    // The outgoing delay runs first, on copies, since the incoming one overwrites the block
+    juce::dsp::AudioBlock<SampleType> fadeBlock, fadeWetBlock;
+
+    if (state.delayFadeSamplesLeft > 0)
+    {
+        auto fadeChannels = juce::dsp::AudioBlock<SampleType>(state.delayFadeBuffer).getSubBlock(0, numSamples);
+        fadeBlock = fadeChannels.getSingleChannelBlock((size_t)channel * 2);
+        fadeBlock.copyFrom(block);
+
+        if (delayWetBlock.getNumChannels() > 0)
+            fadeWetBlock = fadeChannels.getSingleChannelBlock((size_t)channel * 2 + 1);
+
+        if (useMultiband)
+            processDelay(delay, fadeBlock, fadeWetBlock);
+        else
+            processDelay(multiband, fadeBlock, fadeWetBlock);
+    }
+
+    if (useMultiband)
+        processDelay(multiband, block, delayWetBlock);
+    else
+        processDelay(delay, block, delayWetBlock);
+
+    if (state.delayFadeSamplesLeft == 0)
+        return;
+
+    const auto numToFade = juce::jmin(numSamples, (size_t)state.delayFadeSamplesLeft);
+    auto* output = block.getChannelPointer(0);
+    const auto* fading = fadeBlock.getChannelPointer(0);
+    auto* wetOutput = fadeWetBlock.getNumChannels() > 0 ? delayWetBlock.getChannelPointer(0) : nullptr;
+    const auto* fadingWet = fadeWetBlock.getNumChannels() > 0 ? fadeWetBlock.getChannelPointer(0) : nullptr;
+
+    for (size_t i = 0; i < numToFade; ++i)
+    {
+        const auto t = SampleType(state.delayFadeSamplesLeft - (int)i) / SampleType(delayFadeLength);
+        output[i] += t * (fading[i] - output[i]);
+
+        if (wetOutput != nullptr)
+            wetOutput[i] += t * (fadingWet[i] - wetOutput[i]);
+    }
+}
+
+template <typename SampleType>
+void DubEchoAudioProcessor::processInternalBlocks(juce::AudioBuffer<SampleType>& buffer)
+{
+    auto& internalBlockBuffer = getChainState<SampleType>().internalBlockBuffer;
+    const auto numChannels = juce::jmin(buffer.getNumChannels(), internalBlockBuffer.getNumChannels());
+    const auto numSamples = buffer.getNumSamples();
+
+    for (auto start = 0; start < numSamples;)
+    {
+        const auto numToSwap = juce::jmin(numSamples - start, internalBlockSize - internalBlockPosition);
+
+        // Each slot of the internal block still holds its output from the previous pass,
+        // so swapping hands that to the host and queues the new input in one go.
+        for (auto ch = 0; ch < numChannels; ++ch)
+        {
+            auto* hostData = buffer.getWritePointer(ch, start);
+            std::swap_ranges(hostData, hostData + numToSwap, internalBlockBuffer.getWritePointer(ch, internalBlockPosition));
+        }
+
+        start += numToSwap;
+        internalBlockPosition += numToSwap;
+
+        if (internalBlockPosition == internalBlockSize)
+        {
+            processChain(internalBlockBuffer);
+            internalBlockPosition = 0;
+        }
+    }
 }
 
 //==============================================================================
@@ -193,7 +632,7 @@ void DubEchoAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
     // You could do that either as raw data, or use the XML or ValueTree classes
     // as intermediaries to make it easy to save and load complex data.
     juce::MemoryOutputStream mos(destData, true);
-    apvts.state.writeToStream(mos);
+    withoutStatusParameters(apvts.copyState()).writeToStream(mos);
 }
 
 void DubEchoAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
@@ -203,10 +642,26 @@ void DubEchoAudioProcessor::setStateInformation (const void* data, int sizeInByt
     auto tree = juce::ValueTree::readFromData(data, sizeInBytes);
     if (tree.isValid())
     {
-        apvts.replaceState(tree);
+        // Sessions saved before the tier was left out still carry it
+        apvts.replaceState(withoutStatusParameters(tree));
+
+        if (auto* tierParameter = apvts.getParameter("Quality Tier"))
+            tierParameter->setValueNotifyingHost(tierParameter->convertTo0to1((float)reportedTier));
     }
 }
 
+// The tier describes this machine's load right now, so it is neither saved nor
+// restored; setStateInformation puts the live tier back after replacing the state.
+juce::ValueTree DubEchoAudioProcessor::withoutStatusParameters(juce::ValueTree state)
+{
+    auto tier = state.getChildWithProperty("id", "Quality Tier");
+
+    if (tier.isValid())
+        state.removeChild(tier, nullptr);
+
+    return state;
+}
+
 //==============================================================================
 // This creates new instances of the plugin..
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
@@ -214,16 +669,68 @@ juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
     return new DubEchoAudioProcessor();
 }
 
-ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
+ChainParameters getChainParameters(juce::AudioProcessorValueTreeState& apvts)
+{
+    ChainParameters parameters;
+
+    parameters.reverbSize = apvts.getRawParameterValue("Reverb Size");
+    parameters.reverbDamping = apvts.getRawParameterValue("Reverb Damping");
+    parameters.reverbWet = apvts.getRawParameterValue("Reverb Dry/Wet");
+    parameters.delayTime = apvts.getRawParameterValue("Delay Time");
+    parameters.delayFeedBack = apvts.getRawParameterValue("Delay Feedback");
+    parameters.delayWet = apvts.getRawParameterValue("Delay Dry/Wet");
+    parameters.qualityLock = apvts.getRawParameterValue("Quality Lock");
+    parameters.duckAmount = apvts.getRawParameterValue("Duck Amount");
+    parameters.duckRelease = apvts.getRawParameterValue("Duck Release");
+    parameters.duckSource = apvts.getRawParameterValue("Duck Source");
+    parameters.delayFreeze = apvts.getRawParameterValue("Delay Freeze");
+    parameters.reverbFreeze = apvts.getRawParameterValue("Reverb Freeze");
+    parameters.saturationOversampling = apvts.getRawParameterValue("Saturation Oversampling");
+    parameters.delayBands = apvts.getRawParameterValue("Delay Bands");
+    parameters.internalBlockSize = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("Internal Block Size"));
+    parameters.wetDecimation = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("Wet Decimation"));
+
+    for (auto band = 0; band < maxNumDelayBands; ++band)
+    {
+        auto prefix = "Band " + juce::String(band + 1);
+        parameters.bandFeedBack[band] = apvts.getRawParameterValue(prefix + " Feedback");
+        parameters.bandOffset[band] = apvts.getRawParameterValue(prefix + " Offset");
+        parameters.bandDrive[band] = apvts.getRawParameterValue(prefix + " Drive");
+    }
+
+    return parameters;
+}
+
+ChainSettings getChainSettings(const ChainParameters& parameters)
 {
     ChainSettings settings;
 
-    settings.reverbSize = apvts.getRawParameterValue("Reverb Size")->load();
-    settings.reverbDamping = apvts.getRawParameterValue("Reverb Damping")->load();
-    settings.reverbWet = apvts.getRawParameterValue("Reverb Dry/Wet")->load();
-    settings.delayTime = apvts.getRawParameterValue("Delay Time")->load();
-    settings.delayFeedBack = apvts.getRawParameterValue("Delay Feedback")->load();
-    settings.delayWet = apvts.getRawParameterValue("Delay Dry/Wet")->load();
+    settings.reverbSize = parameters.reverbSize->load();
+    settings.reverbDamping = parameters.reverbDamping->load();
+    settings.reverbWet = parameters.reverbWet->load();
+    settings.delayTime = parameters.delayTime->load();
+    settings.delayFeedBack = parameters.delayFeedBack->load();
+    settings.delayWet = parameters.delayWet->load();
+    settings.qualityLock = parameters.qualityLock->load() > 0.5f;
+    settings.duckAmount = parameters.duckAmount->load();
+    settings.duckRelease = parameters.duckRelease->load();
+    settings.duckFromSidechain = parameters.duckSource->load() > 0.5f;
+    settings.delayFreeze = parameters.delayFreeze->load() > 0.5f;
+    settings.reverbFreeze = parameters.reverbFreeze->load() > 0.5f;
+
+    // Choice index 0 is "Off", then 2x and 4x
+    settings.saturationOversampling = 1 << (int)parameters.saturationOversampling->load();
+
+    // Choice index 0 is "Off", then 2, 3 and 4 bands
+    auto bandChoice = (int)parameters.delayBands->load();
+    settings.delayBands = bandChoice == 0 ? 1 : bandChoice + 1;
+
+    for (size_t band = 0; band < maxNumDelayBands; ++band)
+    {
+        settings.bandFeedBack[band] = parameters.bandFeedBack[band]->load();
+        settings.bandOffset[band] = parameters.bandOffset[band]->load();
+        settings.bandDrive[band] = parameters.bandDrive[band]->load();
+    }
 
     return settings;
 }
@@ -242,7 +749,7 @@ juce::AudioProcessorValueTreeState::ParameterLayout DubEchoAudioProcessor::creat
         "Reverb Dry/Wet", juce::NormalisableRange<float>(0.f, 1.f, 0.01f, 1.f), 0.5f));
 
     layout.add(std::make_unique<juce::AudioParameterFloat>("Delay Time",
-        "Delay Time", juce::NormalisableRange<float>(0.f, 2.f, 0.01f, 1.f), 0.5f));
+        "Delay Time", juce::NormalisableRange<float>(0.f, maxDelayTimeSeconds, 0.01f, 1.f), 0.5f));
 
     layout.add(std::make_unique<juce::AudioParameterFloat>("Delay Feedback",
         "DelayFeedback", juce::NormalisableRange<float>(0.f, 1.f, 0.01f, 1.f), 0.5f));
@@ -250,6 +757,62 @@ juce::AudioProcessorValueTreeState::ParameterLayout DubEchoAudioProcessor::creat
     layout.add(std::make_unique<juce::AudioParameterFloat>("Delay Dry/Wet",
         "Delay Dry/Wet", juce::NormalisableRange<float>(0.f, 1.f, 0.01f, 1.f), 0.5f));
 
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Delay Bands",
+        "Delay Bands", juce::StringArray{ "Off", "2", "3", "4" }, 0));
+
+    for (auto band = 1; band <= maxNumDelayBands; ++band)
+    {
+        auto prefix = "Band " + juce::String(band);
+
+        layout.add(std::make_unique<juce::AudioParameterFloat>(prefix + " Feedback",
+            prefix + " Feedback", juce::NormalisableRange<float>(0.f, 1.f, 0.01f, 1.f), 0.5f));
+
+        layout.add(std::make_unique<juce::AudioParameterFloat>(prefix + " Offset",
+            prefix + " Offset", juce::NormalisableRange<float>(-0.25f, 0.25f, 0.001f, 1.f), 0.f));
+
+        layout.add(std::make_unique<juce::AudioParameterFloat>(prefix + " Drive",
+            prefix + " Drive", juce::NormalisableRange<float>(1.f, 10.f, 0.01f, 0.5f), 1.f));
+    }
+
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Saturation Oversampling",
+        "Saturation Oversampling", juce::StringArray{ "Off", "2x", "4x" }, 0));
+
+    layout.add(std::make_unique<juce::AudioParameterBool>("Delay Freeze",
+        "Delay Freeze", false));
+
+    layout.add(std::make_unique<juce::AudioParameterBool>("Reverb Freeze",
+        "Reverb Freeze", false));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>("Duck Amount",
+        "Duck Amount", juce::NormalisableRange<float>(0.f, 1.f, 0.01f, 1.f), 0.f));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>("Duck Release",
+        "Duck Release", juce::NormalisableRange<float>(0.01f, 1.f, 0.001f, 0.5f), 0.25f));
+
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Duck Source",
+        "Duck Source", juce::StringArray{ "Input", "Sidechain" }, 0));
+
+    layout.add(std::make_unique<juce::AudioParameterBool>("Quality Lock",
+        "Quality Lock", false));
+
+    // Written by the plugin to report the tier the quality governor has picked
+    layout.add(std::make_unique<StatusChoiceParameter>("Quality Tier",
+        "Quality Tier", juce::StringArray{ "High", "Economy" }, 0));
+
+    // Choice names are the sizes
+    juce::StringArray blockSizes{ "Off" };
+    const auto defaultBlockSize = juce::String(DUBECHO_FIXED_BLOCK_SIZE);
+
+    for (auto size : getInternalBlockSizes())
+        blockSizes.add(juce::String(size));
+
+    layout.add(std::make_unique<SetupChoiceParameter>("Internal Block Size",
+        "Internal Block Size", blockSizes, juce::jmax(0, blockSizes.indexOf(defaultBlockSize))));
+
+    layout.add(std::make_unique<SetupChoiceParameter>("Wet Decimation",
+        "Wet Decimation", juce::StringArray{ "Off", "2x", "4x" },
+        DUBECHO_WET_DECIMATION == 4 ? 2 : (DUBECHO_WET_DECIMATION == 2 ? 1 : 0)));
+
     return layout;
 }
 float DubEchoAudioProcessor::getRmsValue(const int channel) const
@@ -261,14 +824,73 @@ float DubEchoAudioProcessor::getRmsValue(const int channel) const
         return rmsLevelRight.getCurrentValue();
     return 0.f;
 }
-void DubEchoAudioProcessor::updateRmsVal(juce::AudioBuffer<float>& buffer)
+
+bool DubEchoAudioProcessor::setInternalBlockSize(int numSamples)
+{
+    auto* parameter = chainParameters.internalBlockSize;
+    const auto index = numSamples == 0 ? 0 : parameter->choices.indexOf(juce::String(numSamples));
+
+    // Only the sizes the parameter offers can be set
+    if (numSamples < 0 || index < 0)
+        return false;
+
+    parameter->setValueNotifyingHost(parameter->convertTo0to1((float)index));
+    return true;
+}
+
+// 64 and 128, and a build default other than those gets its own choice
+juce::Array<int> DubEchoAudioProcessor::getInternalBlockSizes()
+{
+    juce::Array<int> sizes{ 64, 128 };
+
+    if (DUBECHO_FIXED_BLOCK_SIZE > 0)
+        sizes.addIfNotAlreadyThere(DUBECHO_FIXED_BLOCK_SIZE);
+
+    return sizes;
+}
+
+bool DubEchoAudioProcessor::setWetDecimation(int factor)
+{
+    if (factor != 1 && factor != 2 && factor != 4)
+        return false;
+
+    auto* parameter = chainParameters.wetDecimation;
+    parameter->setValueNotifyingHost(parameter->convertTo0to1(factor == 4 ? 2.f : (factor == 2 ? 1.f : 0.f)));
+    return true;
+}
+
+// "Off" parses as 0, the other choices are the sizes themselves
+int DubEchoAudioProcessor::getInternalBlockSizeSetting() const
+{
+    return chainParameters.internalBlockSize->getCurrentChoiceName().getIntValue();
+}
+
+// Choice index 0 is "Off", then 2x and 4x
+int DubEchoAudioProcessor::getWetDecimationSetting() const
+{
+    return 1 << chainParameters.wetDecimation->getIndex();
+}
+
+template <typename SampleType>
+void DubEchoAudioProcessor::updateRmsVal(juce::AudioBuffer<SampleType>& buffer)
 {
     juce::ScopedNoDenormals noDenormals;
     const auto numSamples = buffer.getNumSamples();
     rmsLevelLeft.skip(numSamples);
     rmsLevelRight.skip(numSamples);
+
+    // Same as AudioBuffer::getRMSLevel, with the sum in the SIMD kernels
+    auto getRmsLevel = [&](int channel)
+    {
+        if (numSamples <= 0)
+            return SampleType(0);
+
+        const auto sum = SimdKernels::sumOfSquares(*kernels, buffer.getReadPointer(channel), (size_t)numSamples);
+        return std::sqrt(sum / (SampleType)numSamples);
+    };
+
     {
-        const auto value = juce::Decibels::gainToDecibels(buffer.getRMSLevel(0, 0, numSamples));
+        const auto value = (float)juce::Decibels::gainToDecibels(getRmsLevel(0));
         if (value < rmsLevelLeft.getCurrentValue())
             rmsLevelLeft.setTargetValue(value);
         else
@@ -276,7 +898,7 @@ void DubEchoAudioProcessor::updateRmsVal(juce::AudioBuffer<float>& buffer)
     }
 
     {
-        const auto value = juce::Decibels::gainToDecibels(buffer.getRMSLevel(1, 0, numSamples));
+        const auto value = (float)juce::Decibels::gainToDecibels(getRmsLevel(1));
         if (value < rmsLevelRight.getCurrentValue())
             rmsLevelRight.setTargetValue(value);
         else
@@ -286,40 +908,168 @@ void DubEchoAudioProcessor::updateRmsVal(juce::AudioBuffer<float>& buffer)
 
 void DubEchoAudioProcessor::updateFXChain()
 {
-    auto settings = getChainSettings(apvts);
-    updateDelay(settings);
-    updateReverb(settings);
+    auto settings = getChainSettings(chainParameters);
+    governor.setLocked(settings.qualityLock);
+
+    if (isUsingDoublePrecision())
+    {
+        updateDelay(doubleState, settings);
+        updateReverb(doubleState, settings);
+    }
+    else
+    {
+        updateDelay(floatState, settings);
+        updateReverb(floatState, settings);
+    }
 }
 
-void DubEchoAudioProcessor::updateDelay(ChainSettings& settings)
+template <typename SampleType>
+void DubEchoAudioProcessor::updateDelay(ChainState<SampleType>& state, ChainSettings& settings)
 {
 
-    auto& leftDelay = leftChain.get<ChainPositions::delay>();
-    auto& rightDelay = rightChain.get<ChainPositions::delay>();
+    auto& leftDelay = state.leftChain.template get<ChainPositions::delay>();
+    auto& rightDelay = state.rightChain.template get<ChainPositions::delay>();
 
     leftDelay.setDelayTime(0, settings.delayTime);
-    leftDelay.setDelayTime(1, settings.delayTime);
     leftDelay.setFeedback(settings.delayFeedBack);
     leftDelay.setWetLevel(settings.delayWet);
 
     rightDelay.setDelayTime(0, settings.delayTime);
-    rightDelay.setDelayTime(1, settings.delayTime);
     rightDelay.setFeedback(settings.delayFeedBack);
     rightDelay.setWetLevel(settings.delayWet);
 
+    leftDelay.setFreeze(settings.delayFreeze);
+    rightDelay.setFreeze(settings.delayFreeze);
+
+    leftDelay.setDucking(settings.duckAmount, settings.duckRelease);
+    rightDelay.setDucking(settings.duckAmount, settings.duckRelease);
+
+    // Falls back to keying from the input when the host hasn't enabled the sidechain
+    duckFromSidechain = settings.duckFromSidechain && sidechainEnabled;
+
+    // The economy tier also drops the saturator back to the base rate and shares
+    // one reverb between the channels, see updateReverb
+    const auto useFastSaturation = governor.getTier() != QualityGovernor::high;
+    const auto oversampling = useFastSaturation ? 1 : settings.saturationOversampling;
+    leftDelay.setFastSaturation(useFastSaturation);
+    rightDelay.setFastSaturation(useFastSaturation);
+    leftDelay.setSaturationOversampling(oversampling);
+    rightDelay.setSaturationOversampling(oversampling);
+
+    // Until the timer has built both multiband lines the single band delay stands in.
+    // Switching between them crossfades, and a switch asked for mid-fade waits for the
+    // fade to end, as the saturator's factor changes do.
+    auto& leftMultiband = state.leftChain.template get<ChainPositions::multibandDelay>();
+    auto& rightMultiband = state.rightChain.template get<ChainPositions::multibandDelay>();
+    const auto leftReady = leftMultiband.acquireLine();
+    const auto rightReady = rightMultiband.acquireLine();
+    const auto usingMultiband = ! state.leftChain.template isBypassed<ChainPositions::multibandDelay>();
+    const auto useMultiband = state.delayFadeSamplesLeft > 0 ? usingMultiband
+                                                             : settings.delayBands > 1 && leftReady && rightReady;
+
+    if (useMultiband != usingMultiband)
+        state.delayFadeSamplesLeft = delayFadeLength;
+
+    for (auto* chain : { &state.leftChain, &state.rightChain })
+    {
+        chain->template setBypassed<ChainPositions::delay>(useMultiband);
+        chain->template setBypassed<ChainPositions::multibandDelay>(! useMultiband);
+
+        if (! useMultiband)
+            continue;
+
+        auto& multiband = chain->template get<ChainPositions::multibandDelay>();
+        multiband.setNumBands((size_t)settings.delayBands);
+        multiband.setDelayTime(juce::jmin(settings.delayTime, maxMultibandDelayTimeSeconds));
+        multiband.setWetLevel(settings.delayWet);
+        multiband.setDucking(settings.duckAmount, settings.duckRelease);
+        multiband.setFreeze(settings.delayFreeze);
+
+        for (size_t band = 0; band < maxNumDelayBands; ++band)
+        {
+            multiband.setBandFeedback(band, settings.bandFeedBack[band]);
+            multiband.setBandOffset(band, settings.bandOffset[band]);
+            multiband.setBandDrive(band, settings.bandDrive[band]);
+        }
+    }
+
 }
 
-void DubEchoAudioProcessor::updateReverb(ChainSettings& settings)
+template <typename SampleType>
+void DubEchoAudioProcessor::updateReverb(ChainState<SampleType>& state, ChainSettings& settings)
 {
-    auto& leftReverb = leftChain.get<ChainPositions::reverb>();
-    auto& rightReverb = rightChain.get<ChainPositions::reverb>();
+    auto& leftReverb = state.leftChain.template get<ChainPositions::reverb>();
+    auto& rightReverb = state.rightChain.template get<ChainPositions::reverb>();
 
     auto parameters = leftReverb.getParameters();
+
+    // The reverbs produce only their wet signal, and processReverbs applies the dry
+    // gain they would otherwise have used
+    const auto dryLevel = 1.f - settings.reverbWet;
+    const auto reverbDryLevel = 0.f;
+
+    for (auto& gain : reverbDryGains)
+        gain.setTargetValue(dryLevel * reverbDryScaleFactor);
+
+    // The economy tier runs one reverb for both channels
+    reverbShare.setTargetValue(governor.getTier() == QualityGovernor::high ? 0.f : 1.f);
+
+    // setParameters restarts the reverb's smoothing, so skip it when nothing moved
+    if (parameters.wetLevel == settings.reverbWet
+     && parameters.dryLevel == reverbDryLevel
+     && parameters.damping == settings.reverbDamping
+     && parameters.roomSize == settings.reverbSize
+     && (parameters.freezeMode >= 0.5f) == settings.reverbFreeze)
+        return;
+
+    parameters.freezeMode = settings.reverbFreeze ? 1.f : 0.f;
+
     parameters.wetLevel = settings.reverbWet;
     parameters.damping = settings.reverbDamping;
-    parameters.dryLevel = 1.f - parameters.wetLevel;
+    parameters.dryLevel = reverbDryLevel;
     parameters.roomSize = settings.reverbSize;
 
     leftReverb.setParameters(parameters);
     rightReverb.setParameters(parameters);
 }
+
+template <typename SampleType>
+void DubEchoAudioProcessor::allocateMultibandLines(ChainState<SampleType>& state)
+{
+    state.leftChain.template get<ChainPositions::multibandDelay>().allocateLine();
+    state.rightChain.template get<ChainPositions::multibandDelay>().allocateLine();
+}
+
+void DubEchoAudioProcessor::timerCallback()
+{
+    // The multiband lines are only built once "Delay Bands" is first turned on,
+    // here rather than on the audio thread
+    if (getChainSettings(chainParameters).delayBands > 1)
+    {
+        if (isUsingDoublePrecision())
+            allocateMultibandLines(doubleState);
+        else
+            allocateMultibandLines(floatState);
+    }
+
+    // A new block size or decimation only takes effect in prepareToPlay. Reporting a
+    // latency change makes hosts stop, re-prepare and restart the plugin.
+    const auto blockSize = getInternalBlockSizeSetting();
+    const auto decimation = getWetDecimationSetting();
+
+    if (blockSize != requestedInternalBlockSize || decimation != requestedWetDecimation)
+    {
+        requestedInternalBlockSize = blockSize;
+        requestedWetDecimation = decimation;
+        updateHostDisplay(juce::AudioProcessorListener::ChangeDetails().withLatencyChanged(true));
+    }
+
+    // The tier parameter is only there to show the host what the governor picked
+    if (governor.getTier() == reportedTier)
+        return;
+
+    reportedTier = governor.getTier();
+
+    if (auto* tierParameter = apvts.getParameter("Quality Tier"))
+        tierParameter->setValueNotifyingHost(tierParameter->convertTo0to1((float)reportedTier));
+}
@@ -8,225 +8,125 @@
 
 #pragma once
 #include <JuceHeader.h>
+#include "AnalyserFifo.h"
+#include "MultibandDelay.h"
+#include "QualityGovernor.h"
+#include "SimdKernels.h"
+#include "Delay.h"
+#include "TelemetryPublisher.h"
+
+// Set DUBECHO_LONG_DELAY to 1 to build the long-delay variant, which allows up to
+// 30 s of echo and stores the delay lines as 16-bit samples instead of floats.
+#ifndef DUBECHO_LONG_DELAY
+ #define DUBECHO_LONG_DELAY 0
+#endif
+
+// Set DUBECHO_FIXED_BLOCK_SIZE to a non-zero number of samples to make that the default
+// of the "Internal Block Size" parameter, which runs the FX chain on blocks of that size
+// whatever the host buffer size is, at the cost of that much latency.
+#ifndef DUBECHO_FIXED_BLOCK_SIZE
+ #define DUBECHO_FIXED_BLOCK_SIZE 0
+#endif
+
+// Set DUBECHO_WET_DECIMATION to 2 or 4 to make that the default of the "Wet Decimation"
+// parameter, which runs the delay's feedback loop at that fraction of the sample rate,
+// trading the echoes' top end for CPU and memory. See Delay::setWetDecimation.
+#ifndef DUBECHO_WET_DECIMATION
+ #define DUBECHO_WET_DECIMATION 1
+#endif
 
 //==============================================================================
-template <typename Type> 
-class DelayLine
+enum ChainPositions
 {
-public:
-    void clear() noexcept
-    {
-        std::fill(rawData.begin, rawData.end(), Type(0));
-    }
-
-    size_t size() const noexcept
-    {
-        return rawData.size();
-    }
-
-    void resize(size_t newValue)
-    {
-        rawData.resize(newValue);
-        leastRecentIndex = 0;
-    }
-
-    Type back() const noexcept
-    {
-        return rawData[leastRecentIndex];
-    }
-
-    Type get(size_t delayInSamples) const noexcept
-    {
-        jassert(delayInSamples >= 0 && delayInSamples < size());
-        return rawData[(leastRecentIndex + 1 + delayInSamples) % size()];
-    }
-
-    Type set(size_t delayInSamples, Type newValue) noexcept
-    {
-        jassert(delayInSamples >= 0 && delayInSamples < size());
-        rawData[(leastRecentIndex + 1 + delayInSamples) % size()] = newValue;
-    }
+    reverb,
+    delay,
+    multibandDelay,
+};
 
-    void push(Type valueToAdd) noexcept
-    {
-        rawData[leastRecentIndex] = valueToAdd;
-        leastRecentIndex = leastRecentIndex == 0 ? size() - 1 : leastRecentIndex - 1;
-    }
+constexpr int maxNumDelayBands = 4;
 
-private:
-    std::vector<Type> rawData;
-    size_t leastRecentIndex = 0;
+struct ChainSettings
+{
+    float reverbSize{ 0.5f }, reverbDamping{ 0.5f }, reverbWet{ 0.5f };
+    float delayTime{ 0.5f }, delayFeedBack{ 0.5f }, delayWet{ 0 };
+    bool qualityLock{ false };
+    float duckAmount{ 0 }, duckRelease{ 0.25f };
+    bool duckFromSidechain{ false };
+    bool delayFreeze{ false }, reverbFreeze{ false };
+    int saturationOversampling{ 1 };
+
+    // 1 runs the single band Delay, more runs the MultibandDelay instead
+    int delayBands{ 1 };
+    std::array<float, maxNumDelayBands> bandFeedBack{}, bandOffset{}, bandDrive{};
 };
 
-//==============================================================================
-template <typename Type, size_t maxNumChannels = 2>
-class Delay
+// Pointers to the raw parameter values, looked up once so the audio thread never
+// has to build parameter ID strings or search the tree for them
+struct ChainParameters
 {
-public:
-    //==============================================================================
-    Delay()
-    {
-        setMaxDelayTime(2.1f);
-        setDelayTime(0, 0.7f);
-        setDelayTime(1, 0.5f);
-        setWetLevel(0.5f);
-        setFeedback(0.5f);
-    }
-
-    //==============================================================================
-    void prepare(const juce::dsp::ProcessSpec& spec)
-    {
-        jassert(spec.numChannels <= maxNumChannels);
-        sampleRate = (Type)spec.sampleRate;
-        updateDelayLineSize();
-        updateDelayTime();
-
-        filterCoefs = juce::dsp::IIR::Coefficients<Type>::makeFirstOrderHighPass(sampleRate, Type(1e3));
-
-        for (auto& f : filters)
-        {
-            f.prepare(spec);
-            f.coefficients = filterCoefs;
-        }
-    }
-
-    //==============================================================================
-    void reset() noexcept
-    {
-        for (auto& f : filters)
-            filters.reset();
-
-        for (auto& dline : delayLines)
-            dline.clear();
-    }
-
-    //==============================================================================
-    size_t getNumChannels() const noexcept
-    {
-        return delayLines.size();
-    }
-
-    //==============================================================================
-    void setMaxDelayTime(Type newValue)
-    {
-        jassert(newValue > Type(0));
-        maxDelayTime = newValue;
-        updateDelayLineSize();
-    }
-
-    //==============================================================================
-    void setFeedback(Type newValue) noexcept
-    {
-        jassert(newValue >= Type(0) && newValue <= Type(1));
-        feedback = newValue;
-    }
-
-    //==============================================================================
-    void setWetLevel(Type newValue) noexcept
-    {
-        jassert(newValue >= Type(0) && newValue <= Type(1));
-        wetLevel = newValue;
-    }
-
-    //==============================================================================
-    void setDelayTime(size_t channel, Type newValue)
-    {
-        if (channel >= getNumChannels())
-        {
-            jassertfalse;
-            return;
-        }
-
-        jassert(newValue >= Type(0));
-        delayTimes[channel] = newValue;
-
-        updateDelayTime();
-    }
-
-    //==============================================================================
-    template <typename ProcessContext>
-    void process(const ProcessContext& context) noexcept
-    {
-        auto& inputBlock = context.getInputBlock();
-        auto& outputBlock = context.getOutputBlock();
-        auto numSamples = outputBlock.getNumSamples();
-        auto numChannels = outputBlock.getNumChannels();
-
-        jassert(inputBlock.getNumSamples() == numSamples);
-        jassert(inputBlock.getNumChannels() == numChannels);
-
-        juce::ignoreUnused(numSamples);
-
-        for (size_t ch = 0; ch < numChannels; ++ch)
-        {
-            auto* input = inputBlock.getChannelPointer(ch);
-            auto* output = outputBlock.getChannelPointer(ch);
-            auto& dline = delayLines[ch];
-            auto delayTime = delayTimesSample[ch];
-            auto& filter = filters[ch];
-
-            for (size_t i = 0; i < numSamples; ++i)
-            {
-                auto delayedSample = filter.processSample(dline.get(delayTime));
-                auto inputSample = input[i];
-                auto dlineInputSample = std::tanh(inputSample + feedback * delayedSample);
-                dline.push(dlineInputSample);
-                auto outputSample = inputSample + wetLevel * delayedSample;
-                output[i] = outputSample;
-            }
-        }
-    }
-
-private:
-    std::array<DelayLine<Type>, maxNumChannels> delayLines;
-    std::array<size_t, maxNumChannels> delayTimesSample;
-    std::array<Type, maxNumChannels> delayTimes;
-    Type feedback{ Type(0) };
-    Type wetLevel{ Type(0) };
-
-    std::array<juce::dsp::IIR::Filter<Type>, maxNumChannels> filters;
-    typename juce::dsp::IIR::Coefficients<Type>::Ptr filterCoefs;
-
-    Type sampleRate{ Type(44.1e3) };
-    Type maxDelayTime{ Type(2) };
-
-    //==============================================================================
-    void updateDelayLineSize()
-    {
-        auto delayLineSizeSamples = (size_t)std::ceil(maxDelayTime * sampleRate);
+    std::atomic<float>* reverbSize{ nullptr }, * reverbDamping{ nullptr }, * reverbWet{ nullptr };
+    std::atomic<float>* delayTime{ nullptr }, * delayFeedBack{ nullptr }, * delayWet{ nullptr };
+    std::atomic<float>* qualityLock{ nullptr };
+    std::atomic<float>* duckAmount{ nullptr }, * duckRelease{ nullptr }, * duckSource{ nullptr };
+    std::atomic<float>* delayFreeze{ nullptr }, * reverbFreeze{ nullptr };
+    std::atomic<float>* saturationOversampling{ nullptr };
+
+    std::atomic<float>* delayBands{ nullptr };
+    std::array<std::atomic<float>*, maxNumDelayBands> bandFeedBack{}, bandOffset{}, bandDrive{};
+
+    // Only read when preparing, so the choice names can be parsed there
+    juce::AudioParameterChoice* internalBlockSize{ nullptr }, * wetDecimation{ nullptr };
+};
 
-        for (auto& dline : delayLines)
-        {
-            dline.resize(delayLineSizeSamples);
-        }
-    }
+ChainParameters getChainParameters(juce::AudioProcessorValueTreeState& apvts);
+ChainSettings getChainSettings(const ChainParameters& parameters);
 
-    //==============================================================================
-    void updateDelayTime() noexcept
-    {
-        for (size_t ch = 0; ch < maxNumChannels; ++ch)
-            delayTimesSample[ch] = (size_t)juce::roundToInt(delayTimes[ch] * sampleRate);
-    }
-};
-enum ChainPositions
+// A choice the host shows and saves but can't automate, for settings that only take
+// effect when the host prepares the plugin again
+class SetupChoiceParameter : public juce::AudioParameterChoice
 {
-    reverb,
-    delay,
+public:
+    using juce::AudioParameterChoice::AudioParameterChoice;
+    bool isAutomatable() const override { return false; }
 };
 
-struct ChainSettings
+// A choice only the plugin writes, to show the host its state. The meter category
+// makes it read-only in hosts, and it is left out of the saved state.
+class StatusChoiceParameter : public juce::AudioParameterChoice
 {
-    float reverbSize{ 0.5f }, reverbDamping{ 0.5f }, reverbWet{ 0.5f };
-    float delayTime{ 0.5f }, delayFeedBack{ 0.5f }, delayWet{ 0 };
+public:
+    using juce::AudioParameterChoice::AudioParameterChoice;
+    bool isAutomatable() const override { return false; }
+    Category getCategory() const override { return otherMeter; }
 };
 
-using MonoChain = juce::dsp::ProcessorChain<juce::dsp::Reverb, Delay<float>>;
+#if DUBECHO_LONG_DELAY
+template <typename SampleType>
+using DelayStorageType = int16_t;
+constexpr float maxDelayTimeSeconds = 30.f;
+#else
+template <typename SampleType>
+using DelayStorageType = SampleType;
+constexpr float maxDelayTimeSeconds = 2.f;
+#endif
+
+// The multiband delay keeps a frame of every band per sample of delay, so it stays
+// at the standard range even in the long-delay build.
+constexpr float maxMultibandDelayTimeSeconds = 2.f;
+
+// Each chain processes a single channel, so its delay only needs one line.
+// juce::dsp::Reverb only comes in float, so a double chain converts around it.
+template <typename SampleType>
+using MonoChain = juce::dsp::ProcessorChain<juce::dsp::Reverb,
+                                            Delay<SampleType, 1, DelayStorageType<SampleType>>,
+                                            MultibandDelay<SampleType, maxNumDelayBands>>;
 
 //==============================================================================
 class DubEchoAudioProcessor  : public juce::AudioProcessor
                             #if JucePlugin_Enable_ARA
                              , public juce::AudioProcessorARAExtension
                             #endif
+                             , private juce::Timer
 {
 public:
     //==============================================================================
@@ -242,6 +142,8 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -272,14 +174,116 @@ public:
     juce::AudioProcessorValueTreeState apvts{ *this, nullptr, "Parameters", createParameterLayout() };
 
     float getRmsValue(const int channel) const;
+    AnalyserFifo& getAnalyserFifo() noexcept { return analyserFifo; }
+    QualityGovernor::Tier getQualityTier() const noexcept { return governor.getTier(); }
+
+    // Sets the "Internal Block Size" parameter: 0 to use the host's blocks directly, or
+    // one of getInternalBlockSizes(). Takes effect on the next prepareToPlay, which the
+    // plugin asks the host for and which reports the added latency. Returns false,
+    // leaving the parameter alone, for a size it doesn't offer.
+    bool setInternalBlockSize(int numSamples);
+    static juce::Array<int> getInternalBlockSizes();
+
+    // Sets the "Wet Decimation" parameter to 1, 2 or 4, taking effect the same way, and
+    // returns false for any other factor
+    bool setWetDecimation(int factor);
     
 private:
-    MonoChain leftChain, rightChain;
+    // The FX chain and the buffers it works in, for one processing precision. Only the
+    // one matching the host's precision is prepared, so the other never allocates.
+    template <typename SampleType>
+    struct ChainState
+    {
+        MonoChain<SampleType> leftChain, rightChain;
+        juce::AudioBuffer<SampleType> sidechainKeyBuffer, internalBlockBuffer;
+
+        // After "Delay Bands" switches between the single band and multiband delays,
+        // the outgoing one keeps running for delayFadeLength samples on its own copy of
+        // each channel and its wet stem, and is crossfaded out
+        juce::AudioBuffer<SampleType> delayFadeBuffer;
+        int delayFadeSamplesLeft{ 0 };
+    };
+
+    static constexpr int delayFadeLength = 256;
+
+    ChainParameters chainParameters;
+    ChainState<float> floatState;
+    ChainState<double> doubleState;
     juce::LinearSmoothedValue<float> rmsLevelLeft, rmsLevelRight;
+
+    // Chosen when the processor is made, so never on the audio thread
+    const SimdKernels::Table* kernels{ &SimdKernels::getKernels() };
+    AnalyserFifo analyserFifo;
+    QualityGovernor governor;
+    QualityGovernor::Tier reportedTier{ QualityGovernor::high };
+    TelemetryPublisher telemetry;
+    Telemetry::Stats telemetryStats{};
+    double preparedSampleRate{ 0.0 };
+    juce::uint32 preparedBlockSize{ 0 };
+    bool preparedDoublePrecision{ false };
+    int preparedWetDecimation{ 0 };
+
+    // Output buses after the main one, carrying the wet signals as separate stems
+    enum StemBuses
+    {
+        delayWetBus = 1,
+        reverbWetBus,
+    };
+
+    // A loop feeding back this much or more never dies away, its saturator
+    // holding it up instead
+    static constexpr double maxDecayingFeedback = 0.999;
+
+    // juce::Reverb multiplies its dry level by this before applying it
+    static constexpr float reverbDryScaleFactor = 2.f;
+
+    // Optional input bus after the main one, used as the ducking key
+    static constexpr int sidechainBus = 1;
+    bool sidechainEnabled{ false }, duckFromSidechain{ false };
+
+    std::array<juce::SmoothedValue<float>, 2> reverbDryGains;
+
+    // How much the right channel uses the left reverb, 1 in the economy tier
+    juce::SmoothedValue<float> reverbShare;
+    bool rightReverbIdle{ false };
+
+    // The reverbs' float inputs in the first two channels and their wet outputs in the next two
+    juce::AudioBuffer<float> reverbBuffer;
+
+    int internalBlockSize{ 0 }, internalBlockPosition{ 0 };
+    int wetDecimation{ 1 };
+
+    // The setup last prepared for or asked of the host, so the host is only asked once
+    int requestedInternalBlockSize{ 0 }, requestedWetDecimation{ 1 };
+    int getInternalBlockSizeSetting() const;
+    int getWetDecimationSetting() const;
     //==============================================================================
-    void updateRmsVal(juce::AudioBuffer<float>& buffer);
+    template <typename SampleType>
+    ChainState<SampleType>& getChainState() noexcept
+    {
+        if constexpr (std::is_same<SampleType, double>::value)
+            return doubleState;
+        else
+            return floatState;
+    }
+
+    template <typename SampleType> void prepareChainState(const juce::dsp::ProcessSpec& spec);
+    template <typename SampleType> void process(juce::AudioBuffer<SampleType>& buffer);
+    template <typename SampleType> void processChain(juce::AudioBuffer<SampleType>& buffer);
+    template <typename SampleType> void processInternalBlocks(juce::AudioBuffer<SampleType>& buffer);
+    template <typename SampleType>
+    void processReverbs(ChainState<SampleType>& state, juce::AudioBuffer<SampleType>& mainBuffer,
+                        juce::AudioBuffer<SampleType>& reverbWetBuffer);
+    template <typename SampleType>
+    void processMonoChain(ChainState<SampleType>& state, int channel, juce::AudioBuffer<SampleType>& mainBuffer,
+                          juce::AudioBuffer<SampleType>& delayWetBuffer, juce::dsp::AudioBlock<SampleType> keyBlock);
+    template <typename SampleType> void updateRmsVal(juce::AudioBuffer<SampleType>& buffer);
+    template <typename SampleType> void publishTelemetry(const juce::AudioBuffer<SampleType>& buffer, juce::int64 startTicks);
     void updateFXChain();
-    void updateDelay(ChainSettings& settings);
-    void updateReverb(ChainSettings& settings);
+    template <typename SampleType> void updateDelay(ChainState<SampleType>& state, ChainSettings& settings);
+    template <typename SampleType> void updateReverb(ChainState<SampleType>& state, ChainSettings& settings);
+    template <typename SampleType> void allocateMultibandLines(ChainState<SampleType>& state);
+    static juce::ValueTree withoutStatusParameters(juce::ValueTree state);
+    void timerCallback() override;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DubEchoAudioProcessor)
 };
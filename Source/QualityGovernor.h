@@ -0,0 +1,87 @@
+#pragma once
+#include <JuceHeader.h>
+
+//==============================================================================
+// Compares how long processBlock takes with the time the host has to deliver the
+// block, and steps the processing quality down when the plugin runs heavy and back
+// up once there is room again. The two thresholds are far apart and every change is
+// held for a while, so the tier doesn't flap around the boundary.
+class QualityGovernor
+{
+public:
+    enum Tier
+    {
+        high,
+        economy,
+    };
+
+    //==============================================================================
+    void prepare(double newSampleRate) noexcept
+    {
+        sampleRate = newSampleRate;
+        smoothedLoad = 0.0;
+        samplesSinceChange = 0;
+        holdSamples = (juce::int64)(holdSeconds * sampleRate);
+    }
+
+    // Pins the tier at high, for mixdowns
+    void setLocked(bool shouldBeLocked) noexcept
+    {
+        locked = shouldBeLocked;
+
+        if (locked)
+            tier = high;
+    }
+
+    Tier getTier() const noexcept
+    {
+        return tier.load();
+    }
+
+    double getLoad() const noexcept
+    {
+        return smoothedLoad;
+    }
+
+    //==============================================================================
+    // Call at the end of each block with the tick count taken at its start
+    void endBlock(juce::int64 startTicks, int numSamples) noexcept
+    {
+        const auto deadline = numSamples / sampleRate;
+
+        if (deadline <= 0.0)
+            return;
+
+        const auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+        const auto alpha = 1.0 - std::exp(-deadline / loadTimeConstant);
+        smoothedLoad += alpha * (elapsed / deadline - smoothedLoad);
+        samplesSinceChange += numSamples;
+
+        if (locked || samplesSinceChange < holdSamples)
+            return;
+
+        if (tier == high && smoothedLoad > stepDownLoad)
+            changeTier(economy);
+        else if (tier == economy && smoothedLoad < stepUpLoad)
+            changeTier(high);
+    }
+
+private:
+    static constexpr double stepDownLoad = 0.35;
+    static constexpr double stepUpLoad = 0.15;
+    static constexpr double loadTimeConstant = 0.5;
+    static constexpr double holdSeconds = 2.0;
+
+    std::atomic<Tier> tier{ high };
+    bool locked{ false };
+
+    double sampleRate{ 44.1e3 };
+    double smoothedLoad{ 0.0 };
+    juce::int64 samplesSinceChange{ 0 }, holdSamples{ 0 };
+
+    void changeTier(Tier newTier) noexcept
+    {
+        tier = newTier;
+        samplesSinceChange = 0;
+    }
+};
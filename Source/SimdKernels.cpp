@@ -0,0 +1,59 @@
+#include <JuceHeader.h>
+
+#define DUBECHO_KERNEL_NAMESPACE baseline
+#define DUBECHO_KERNEL_ISA Isa::baseline
+#include "SimdKernelsImpl.h"
+
+namespace SimdKernels
+{
+    namespace
+    {
+        // DUBECHO_SIMD caps the choice, for comparing the builds on one machine
+        Isa getWidestAllowed() noexcept
+        {
+            const auto requested = juce::SystemStats::getEnvironmentVariable("DUBECHO_SIMD", {}).trim().toLowerCase();
+
+            if (requested == "baseline")
+                return Isa::baseline;
+
+            if (requested == "avx2")
+                return Isa::avx2;
+
+            return Isa::avx512;
+        }
+
+        const Table& chooseKernels() noexcept
+        {
+            const auto widest = getWidestAllowed();
+
+            if (widest >= Isa::avx512 && juce::SystemStats::hasAVX512F())
+                if (auto* table = getAvx512Kernels())
+                    return *table;
+
+            if (widest >= Isa::avx2 && juce::SystemStats::hasAVX2() && juce::SystemStats::hasFMA3())
+                if (auto* table = getAvx2Kernels())
+                    return *table;
+
+            return baseline::kernelTable;
+        }
+    }
+
+    // Called from prepare, so the one-time choice never lands on the audio thread
+    const Table& getKernels() noexcept
+    {
+        static const Table& kernels = chooseKernels();
+        return kernels;
+    }
+
+    const char* getIsaName(Isa isa) noexcept
+    {
+        switch (isa)
+        {
+            case Isa::avx2:     return "AVX2";
+            case Isa::avx512:   return "AVX-512";
+            case Isa::baseline: break;
+        }
+
+        return "baseline";
+    }
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+//==============================================================================
+// The loops that vectorise, across lanes or samples, compiled once per instruction
+// set: the target's baseline (SSE2 on x86-64, NEON on arm64) in SimdKernels.cpp,
+// AVX2 and AVX-512 in SimdKernelsAVX2.cpp and SimdKernelsAVX512.cpp, which the
+// projects build with the matching compiler flag scheme. getKernels picks the
+// widest one the CPU has the first time it is called.
+//
+// The kernels are plain loops the compiler vectorises at each width. Nothing in
+// this header or in SimdKernelsImpl.h may use JUCE or std:: templates: an inline
+// function compiled in the AVX-512 file could otherwise be the copy the linker keeps
+// for the whole program.
+namespace SimdKernels
+{
+    enum class Isa
+    {
+        baseline,
+        avx2,
+        avx512,
+    };
+
+    //==============================================================================
+    // EchoBank's state, as pointers into its one allocation. Lane arrays hold stride
+    // floats; buffers hold a frame of stride floats per sample and advance a frame
+    // per sample.
+    constexpr size_t bankCombs = 8, bankAllPasses = 4;
+
+    enum BankReverbParameter
+    {
+        combDamping,
+        combFeedback,
+        dryGain,
+        wetGain,
+        numBankReverbParameters
+    };
+
+    struct BankState
+    {
+        size_t stride;
+
+        float* combBuffers[bankCombs];
+        float* combLast[bankCombs];
+        size_t combLengths[bankCombs], combPositions[bankCombs];
+        float* allPassBuffers[bankAllPasses];
+        size_t allPassLengths[bankAllPasses], allPassPositions[bankAllPasses];
+        float reverbInputGain;
+
+        // Linear ramps like juce::SmoothedValue, restarted for every lane together
+        float* current[numBankReverbParameters];
+        float* steps[numBankReverbParameters];
+        float* targets[numBankReverbParameters];
+        int rampSamplesLeft;
+
+        float* line;
+        size_t lineSize, writeOffset;
+        int32_t* tapOffsets;
+        float* filterStates;
+        float* feedbacks;
+        float* wetLevels;
+        float b0, b1, a1;
+
+        float* reverbInputs;
+        float* reverbOutputs;
+    };
+
+    //==============================================================================
+    // MultibandDelay's feedback loop. Each frame of the line holds one sample of
+    // every band; bandInputs holds numSamples such frames and wet gets the sum of
+    // the bands' taps for each sample.
+    constexpr size_t multibandLanes = 4;
+
+    template <typename Type>
+    struct MultibandState
+    {
+        Type* frames;
+        size_t lineLength, writeIndex;
+        size_t delaySamples[multibandLanes];
+        Type enables[multibandLanes], feedbacks[multibandLanes], drives[multibandLanes], inverseDrives[multibandLanes];
+
+        const Type* bandInputs;
+        Type* wet;
+    };
+
+    //==============================================================================
+    struct Table
+    {
+        Isa isa;
+        void (*processBank)(BankState&, float* frames, size_t numSamples);
+        void (*processMultibandFloat)(MultibandState<float>&, size_t numSamples);
+        void (*processMultibandDouble)(MultibandState<double>&, size_t numSamples);
+        float (*sumOfSquaresFloat)(const float*, size_t numSamples);
+        double (*sumOfSquaresDouble)(const double*, size_t numSamples);
+        void (*storageToFloat)(const int16_t* line, float* samples, size_t numSamples);
+        void (*storageToDouble)(const int16_t* line, double* samples, size_t numSamples);
+        void (*floatToStorage)(const float* samples, int16_t* line, size_t numSamples, uint32_t ditherCount);
+        void (*doubleToStorage)(const double* samples, int16_t* line, size_t numSamples, uint32_t ditherCount);
+    };
+
+    // Set DUBECHO_SIMD to baseline or avx2 in the environment to use no wider than that
+    const Table& getKernels() noexcept;
+    const char* getIsaName(Isa isa) noexcept;
+
+    template <typename Type>
+    inline void processMultiband(const Table& table, MultibandState<Type>& state, size_t numSamples) noexcept
+    {
+        if constexpr (sizeof(Type) == sizeof(double))
+            table.processMultibandDouble(state, numSamples);
+        else
+            table.processMultibandFloat(state, numSamples);
+    }
+
+    // The plugin's level meters, summed in any order, so not bit-exact with a plain loop
+    template <typename Type>
+    inline Type sumOfSquares(const Table& table, const Type* samples, size_t numSamples) noexcept
+    {
+        if constexpr (sizeof(Type) == sizeof(double))
+            return table.sumOfSquaresDouble(samples, numSamples);
+        else
+            return table.sumOfSquaresFloat(samples, numSamples);
+    }
+
+    // Converts between samples and a 16-bit DelayLine's storage, with line pointing at
+    // the sample for samples[0] and the rest below it. Writing adds TPDF dither.
+    template <typename Type>
+    inline void storageToSamples(const Table& table, const int16_t* line, Type* samples, size_t numSamples) noexcept
+    {
+        if constexpr (sizeof(Type) == sizeof(double))
+            table.storageToDouble(line, samples, numSamples);
+        else
+            table.storageToFloat(line, samples, numSamples);
+    }
+
+    template <typename Type>
+    inline void samplesToStorage(const Table& table, const Type* samples, int16_t* line, size_t numSamples,
+                                 uint32_t ditherCount) noexcept
+    {
+        if constexpr (sizeof(Type) == sizeof(double))
+            table.doubleToStorage(samples, line, numSamples, ditherCount);
+        else
+            table.floatToStorage(samples, line, numSamples, ditherCount);
+    }
+
+    // Each wider file returns nullptr when it was built without its instruction set
+    const Table* getAvx2Kernels() noexcept;
+    const Table* getAvx512Kernels() noexcept;
+}
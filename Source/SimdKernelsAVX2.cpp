@@ -0,0 +1,21 @@
+// Built with the avx2 compiler flag scheme. Without it the file only reports that
+// it has nothing, so a project that leaves the scheme off still links and runs.
+#if defined(__AVX2__)
+ #define DUBECHO_KERNEL_NAMESPACE avx2
+ #define DUBECHO_KERNEL_ISA Isa::avx2
+ #include "SimdKernelsImpl.h"
+#else
+ #include "SimdKernels.h"
+#endif
+
+namespace SimdKernels
+{
+    const Table* getAvx2Kernels() noexcept
+    {
+       #if defined(__AVX2__)
+        return &avx2::kernelTable;
+       #else
+        return nullptr;
+       #endif
+    }
+}
@@ -0,0 +1,21 @@
+// Built with the avx512 compiler flag scheme. Without it the file only reports that
+// it has nothing, so a project that leaves the scheme off still links and runs.
+#if defined(__AVX512F__)
+ #define DUBECHO_KERNEL_NAMESPACE avx512
+ #define DUBECHO_KERNEL_ISA Isa::avx512
+ #include "SimdKernelsImpl.h"
+#else
+ #include "SimdKernels.h"
+#endif
+
+namespace SimdKernels
+{
+    const Table* getAvx512Kernels() noexcept
+    {
+       #if defined(__AVX512F__)
+        return &avx512::kernelTable;
+       #else
+        return nullptr;
+       #endif
+    }
+}
@@ -0,0 +1,295 @@
+// The kernel bodies. Each SimdKernels*.cpp includes this once with its own
+// DUBECHO_KERNEL_NAMESPACE and DUBECHO_KERNEL_ISA and gets kernelTable back, so every
+// function here has a separate copy per instruction set. No #pragma once on purpose.
+#include "SimdKernels.h"
+
+#if ! defined(DUBECHO_KERNEL_NAMESPACE) || ! defined(DUBECHO_KERNEL_ISA)
+ #error "Define DUBECHO_KERNEL_NAMESPACE and DUBECHO_KERNEL_ISA before including SimdKernelsImpl.h"
+#endif
+
+// GCC unrolls four-lane loops early and then leaves their clamps as branches
+#if defined(__GNUC__) && ! defined(__clang__)
+ #define DUBECHO_KERNEL_LANE_LOOP _Pragma("GCC unroll 1")
+#else
+ #define DUBECHO_KERNEL_LANE_LOOP
+#endif
+
+namespace SimdKernels
+{
+namespace DUBECHO_KERNEL_NAMESPACE
+{
+namespace
+{
+    //==============================================================================
+    // EchoBank. Each stage is its own loop over the lanes with nothing aliased, so
+    // the compiler turns it into straight vector code at the file's width.
+    void stepRamps(BankState& bank) noexcept
+    {
+        if (bank.rampSamplesLeft == 0)
+            return;
+
+        const auto finished = --bank.rampSamplesLeft == 0;
+
+        for (size_t p = 0; p < numBankReverbParameters; ++p)
+        {
+            float* __restrict current = bank.current[p];
+            const float* __restrict step = bank.steps[p];
+            const float* __restrict target = bank.targets[p];
+
+            for (size_t lane = 0; lane < bank.stride; ++lane)
+                current[lane] = finished ? target[lane] : current[lane] + step[lane];
+        }
+    }
+
+    void stepComb(float* __restrict buffer, float* __restrict last, const float* __restrict input,
+                  float* __restrict sum, const float* __restrict damping, const float* __restrict feedback,
+                  size_t stride) noexcept
+    {
+        for (size_t lane = 0; lane < stride; ++lane)
+        {
+            const auto output = buffer[lane];
+            last[lane] = output * (1.f - damping[lane]) + last[lane] * damping[lane];
+            buffer[lane] = input[lane] + last[lane] * feedback[lane];
+            sum[lane] += output;
+        }
+    }
+
+    void stepAllPass(float* __restrict buffer, float* __restrict signal, size_t stride) noexcept
+    {
+        for (size_t lane = 0; lane < stride; ++lane)
+        {
+            const auto buffered = buffer[lane];
+            buffer[lane] = signal[lane] + buffered * 0.5f;
+            signal[lane] = buffered - signal[lane];
+        }
+    }
+
+    // The reverb's mix, then Delay up to its saturator: the high-passed tap is
+    // mixed over the reverb's output and added to its input for the feedback
+    void stepTaps(float* __restrict frame, const float* __restrict reverbOutputs, const float* __restrict dry,
+                  const float* __restrict wet, const float* __restrict line, int32_t* __restrict taps,
+                  float* __restrict filterStates, const float* __restrict feedbacks, const float* __restrict wetLevels,
+                  float* __restrict saturatorInputs, const BankState& bank) noexcept
+    {
+        const auto lineSize = (int32_t)bank.lineSize;
+        const auto stride = (int32_t)bank.stride;
+        const auto b0 = bank.b0, b1 = bank.b1, a1 = bank.a1;
+
+        for (size_t lane = 0; lane < bank.stride; ++lane)
+        {
+            const auto reverbed = reverbOutputs[lane] * wet[lane] + frame[lane] * dry[lane];
+
+            // Transposed direct form, like juce::dsp::IIR::Filter
+            const auto delayed = line[taps[lane]];
+            const auto filtered = delayed * b0 + filterStates[lane];
+            filterStates[lane] = delayed * b1 - filtered * a1;
+
+            auto x = reverbed + feedbacks[lane] * filtered;
+            x = x > 3.f ? 3.f : x;
+            saturatorInputs[lane] = x < -3.f ? -3.f : x;
+            frame[lane] = reverbed + wetLevels[lane] * filtered;
+
+            const auto tap = taps[lane] + stride;
+            taps[lane] = tap - (tap >= lineSize ? lineSize : 0);
+        }
+    }
+
+    // Delay's fast saturation, the Pade approximant of tanh, in a loop of its own
+    // because compilers won't vectorise the clamp and the divide together
+    void stepSaturator(const float* __restrict input, float* __restrict output, size_t stride) noexcept
+    {
+        for (size_t lane = 0; lane < stride; ++lane)
+        {
+            const auto x = input[lane];
+            output[lane] = x * (27.f + x * x) / (27.f + 9.f * x * x);
+        }
+    }
+
+    // The tap is never the frame being written, so reading and writing the line
+    // through separate pointers is safe
+    void stepDelay(BankState& bank, float* frame) noexcept
+    {
+        stepTaps(frame, bank.reverbOutputs, bank.current[dryGain], bank.current[wetGain], bank.line, bank.tapOffsets,
+                 bank.filterStates, bank.feedbacks, bank.wetLevels, bank.reverbInputs, bank);
+
+        stepSaturator(bank.reverbInputs, bank.line + bank.writeOffset, bank.stride);
+        bank.writeOffset += bank.stride;
+
+        if (bank.writeOffset == bank.lineSize)
+            bank.writeOffset = 0;
+    }
+
+    void processBank(BankState& bank, float* frames, size_t numSamples) noexcept
+    {
+        const auto stride = bank.stride;
+        const auto inputGain = bank.reverbInputGain;
+
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            auto* frame = frames + i * stride;
+            stepRamps(bank);
+
+            {
+                float* __restrict input = bank.reverbInputs;
+                float* __restrict sum = bank.reverbOutputs;
+
+                for (size_t lane = 0; lane < stride; ++lane)
+                {
+                    input[lane] = frame[lane] * inputGain;
+                    sum[lane] = 0.f;
+                }
+            }
+
+            for (size_t c = 0; c < bankCombs; ++c)
+            {
+                stepComb(bank.combBuffers[c] + bank.combPositions[c] * stride, bank.combLast[c], bank.reverbInputs,
+                         bank.reverbOutputs, bank.current[combDamping], bank.current[combFeedback], stride);
+
+                if (++bank.combPositions[c] == bank.combLengths[c])
+                    bank.combPositions[c] = 0;
+            }
+
+            for (size_t a = 0; a < bankAllPasses; ++a)
+            {
+                stepAllPass(bank.allPassBuffers[a] + bank.allPassPositions[a] * stride, bank.reverbOutputs, stride);
+
+                if (++bank.allPassPositions[a] == bank.allPassLengths[a])
+                    bank.allPassPositions[a] = 0;
+            }
+
+            stepDelay(bank, frame);
+        }
+    }
+
+    //==============================================================================
+    // MultibandDelay's loop, with the bands as lanes. Four lanes are too few for the
+    // width to matter much; the copies of the settings in locals the frame writes
+    // can't alias, and the three-operand encodings of the wider builds, matter more.
+    template <typename Type>
+    void processMultiband(MultibandState<Type>& state, size_t numSamples) noexcept
+    {
+        constexpr auto lanes = multibandLanes;
+
+        Type enables[lanes], feedbacks[lanes], drives[lanes], inverseDrives[lanes];
+        size_t delaySamples[lanes];
+
+        for (size_t lane = 0; lane < lanes; ++lane)
+        {
+            enables[lane] = state.enables[lane];
+            feedbacks[lane] = state.feedbacks[lane];
+            drives[lane] = state.drives[lane] * Type(2.0 / 3.0);
+            inverseDrives[lane] = state.inverseDrives[lane];
+            delaySamples[lane] = state.delaySamples[lane];
+        }
+
+        Type* __restrict frames = state.frames;
+        const Type* __restrict bandInputs = state.bandInputs;
+        Type* __restrict wet = state.wet;
+        const auto lineLength = state.lineLength;
+        auto writeIndex = state.writeIndex;
+
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            const auto* input = bandInputs + i * lanes;
+            auto* frame = frames + writeIndex * lanes;
+            auto sum = Type(0);
+
+            DUBECHO_KERNEL_LANE_LOOP
+            for (size_t lane = 0; lane < lanes; ++lane)
+            {
+                auto readIndex = writeIndex + lineLength - delaySamples[lane];
+                readIndex -= readIndex >= lineLength ? lineLength : 0;
+                const auto delayed = frames[readIndex * lanes + lane] * enables[lane];
+
+                // MultibandDelay::softClip, the cubic on 2x/3 clamped to [-1, 1],
+                // with the 2/3 folded into the drive
+                const auto x = (input[lane] + feedbacks[lane] * delayed) * drives[lane];
+                const auto upper = x < Type(1) ? x : Type(1);
+                const auto u = upper > Type(-1) ? upper : Type(-1);
+
+                frame[lane] = u * (Type(1.5) - u * u * Type(0.5)) * inverseDrives[lane];
+                sum += delayed;
+            }
+
+            wet[i] = sum;
+            writeIndex = writeIndex + 1 == lineLength ? 0 : writeIndex + 1;
+        }
+
+        state.writeIndex = writeIndex;
+    }
+
+    //==============================================================================
+    // The sum behind a channel's RMS level. A single running sum has to be added in
+    // order, which keeps it scalar without fast-math; independent partial sums let
+    // the compiler keep them in vector registers at the file's width.
+    template <typename Type>
+    Type sumOfSquares(const Type* __restrict samples, size_t numSamples) noexcept
+    {
+        constexpr size_t numSums = 8;
+        Type sums[numSums] = {};
+        size_t i = 0;
+
+        for (; i + numSums <= numSamples; i += numSums)
+            for (size_t k = 0; k < numSums; ++k)
+                sums[k] += samples[i + k] * samples[i + k];
+
+        auto total = Type(0);
+
+        for (; i < numSamples; ++i)
+            total += samples[i] * samples[i];
+
+        for (size_t k = 0; k < numSums; ++k)
+            total += sums[k];
+
+        return total;
+    }
+
+    //==============================================================================
+    // The long-delay build's 16-bit lines. DelayLine is pushed backwards through
+    // memory, so the line side runs from its pointer downwards. The dither comes
+    // from a hash of the sample's count rather than a running generator, so the
+    // lanes don't depend on each other; DelaySampleConverter uses the same hash.
+    // GCC vectorises these at -O3, as the Release configurations build.
+    template <typename Type>
+    void storageToSamples(const int16_t* __restrict line, Type* __restrict samples, size_t numSamples) noexcept
+    {
+        for (size_t i = 0; i < numSamples; ++i)
+            samples[i] = (Type)line[-(ptrdiff_t)i] * Type(1.0 / 32767.0);
+    }
+
+    // The samples come out of Delay's saturator, so they are within [-1, 1] and the
+    // clamp after rounding is for the dither at the extremes. Clamping the floats
+    // before converting would stop the loop vectorising under -ftrapping-math.
+    template <typename Type>
+    void samplesToStorage(const Type* __restrict samples, int16_t* __restrict line, size_t numSamples,
+                          uint32_t ditherCount) noexcept
+    {
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            auto hash = (ditherCount + (uint32_t)i) * 0x9e3779b9u;
+            hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+            hash ^= hash >> 13;
+            const auto dither = (Type)((int32_t)(hash & 0xffff) - (int32_t)(hash >> 16)) * Type(1.0 / 65536.0);
+
+            // Offset to round half up by truncating, as the result is positive
+            auto value = (int32_t)(samples[i] * Type(32767) + dither + Type(32768.5)) - 32768;
+            value = value < 32767 ? value : 32767;
+            value = value > -32767 ? value : -32767;
+            line[-(ptrdiff_t)i] = (int16_t)value;
+        }
+    }
+
+    //==============================================================================
+    const Table kernelTable{ DUBECHO_KERNEL_ISA,
+                             &processBank,
+                             &processMultiband<float>,
+                             &processMultiband<double>,
+                             &sumOfSquares<float>,
+                             &sumOfSquares<double>,
+                             &storageToSamples<float>,
+                             &storageToSamples<double>,
+                             &samplesToStorage<float>,
+                             &samplesToStorage<double> };
+}
+}
+}
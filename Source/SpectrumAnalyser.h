@@ -0,0 +1,247 @@
+#pragma once
+#include <JuceHeader.h>
+#include "AnalyserFifo.h"
+
+namespace GUI
+{
+    // Drains the processor's AnalyserFifo and turns it into spectrum and echo-decay
+    // frames, so none of the analysis runs on the audio or message threads.
+    class AnalyserThread : private juce::Thread
+    {
+    public:
+        static constexpr int fftOrder = 11;
+        static constexpr int fftSize = 1 << fftOrder;
+        static constexpr int numSpectrumPoints = 128;
+        static constexpr int numEnvelopePoints = 300;
+        static constexpr float envelopeSegmentSeconds = 0.01f;
+        static constexpr float minDecibels = -90.f;
+
+        struct Frame
+        {
+            std::array<float, numSpectrumPoints> spectrum;
+            std::array<float, numEnvelopePoints> envelope;
+        };
+
+        explicit AnalyserThread(AnalyserFifo& fifoToUse) : juce::Thread("DubEcho Analyser"), fifo(fifoToUse)
+        {
+            fifo.allocate();
+            scratch.resize(AnalyserFifo::capacity);
+            history.fill(0.f);
+            envelopeHistory.fill(minDecibels);
+            published.spectrum.fill(minDecibels);
+            published.envelope.fill(minDecibels);
+            startThread();
+        }
+
+        ~AnalyserThread() override
+        {
+            stopThread(1000);
+        }
+
+        // Asks for a new frame. The editor calls this at whatever rate it can draw, so
+        // the FFT never runs more often than its result is looked at.
+        void requestFrame()
+        {
+            frameRequested = true;
+            notify();
+        }
+
+        // Copies the latest frame into dest, returning false if there is nothing new.
+        bool getLatestFrame(Frame& dest)
+        {
+            const juce::SpinLock::ScopedLockType lock(frameLock);
+
+            if (! frameReady)
+                return false;
+
+            dest = published;
+            frameReady = false;
+            return true;
+        }
+
+    private:
+        void run() override
+        {
+            while (! threadShouldExit())
+            {
+                wait(drainIntervalMs);
+                drainFifo();
+
+                if (frameRequested.exchange(false))
+                    computeFrame();
+            }
+        }
+
+        void drainFifo()
+        {
+            const auto numRead = fifo.pop(scratch.data(), (int)scratch.size());
+            const auto segmentLength = juce::jmax(1, juce::roundToInt(fifo.getSampleRate() * envelopeSegmentSeconds));
+
+            for (auto i = 0; i < numRead; ++i)
+            {
+                const auto sample = scratch[(size_t)i];
+                history[historyIndex] = sample;
+                historyIndex = (historyIndex + 1) % history.size();
+
+                segmentSumOfSquares += sample * sample;
+
+                if (++segmentPosition >= segmentLength)
+                {
+                    const auto rms = std::sqrt(segmentSumOfSquares / (float)segmentLength);
+                    envelopeHistory[envelopeIndex] = juce::Decibels::gainToDecibels(rms, minDecibels);
+                    envelopeIndex = (envelopeIndex + 1) % envelopeHistory.size();
+                    segmentSumOfSquares = 0.f;
+                    segmentPosition = 0;
+                }
+            }
+        }
+
+        void computeFrame()
+        {
+            // Unroll the history so the oldest sample comes first
+            for (size_t i = 0; i < history.size(); ++i)
+                fftData[i] = history[(historyIndex + i) % history.size()];
+
+            std::fill(fftData.begin() + fftSize, fftData.end(), 0.f);
+            window.multiplyWithWindowingTable(fftData.data(), (size_t)fftSize);
+            fft.performFrequencyOnlyForwardTransform(fftData.data());
+
+            Frame frame;
+            const auto nyquist = (float)fifo.getSampleRate() * 0.5f;
+            const auto binWidth = nyquist / (float)(fftSize / 2);
+            const auto minFrequency = 20.f;
+            const auto maxFrequency = juce::jmin(20e3f, nyquist);
+
+            // Decimate onto log-spaced points, keeping the loudest bin under each one.
+            // The Hann window halves a sine's peak, hence 4 / fftSize rather than 2 / fftSize.
+            auto previousBin = 1;
+            for (auto p = 0; p < numSpectrumPoints; ++p)
+            {
+                const auto proportion = (float)(p + 1) / (float)numSpectrumPoints;
+                const auto frequency = minFrequency * std::pow(maxFrequency / minFrequency, proportion);
+                const auto lastBin = juce::jlimit(previousBin, fftSize / 2 - 1, (int)(frequency / binWidth));
+
+                auto magnitude = 0.f;
+                for (auto bin = previousBin; bin <= lastBin; ++bin)
+                    magnitude = juce::jmax(magnitude, fftData[(size_t)bin]);
+
+                frame.spectrum[(size_t)p] = juce::Decibels::gainToDecibels(magnitude * 4.f / (float)fftSize, minDecibels);
+                previousBin = juce::jmin(lastBin + 1, fftSize / 2 - 1);
+            }
+
+            for (size_t i = 0; i < envelopeHistory.size(); ++i)
+                frame.envelope[i] = envelopeHistory[(envelopeIndex + i) % envelopeHistory.size()];
+
+            const juce::SpinLock::ScopedLockType lock(frameLock);
+            published = frame;
+            frameReady = true;
+        }
+
+        static constexpr int drainIntervalMs = 20;
+
+        AnalyserFifo& fifo;
+        juce::dsp::FFT fft{ fftOrder };
+        juce::dsp::WindowingFunction<float> window{ (size_t)fftSize, juce::dsp::WindowingFunction<float>::hann, false };
+
+        std::vector<float> scratch;
+        std::array<float, fftSize> history;
+        std::array<float, fftSize * 2> fftData;
+        size_t historyIndex = 0;
+
+        std::array<float, numEnvelopePoints> envelopeHistory;
+        size_t envelopeIndex = 0;
+        float segmentSumOfSquares = 0.f;
+        int segmentPosition = 0;
+
+        std::atomic<bool> frameRequested{ false };
+        juce::SpinLock frameLock;
+        Frame published;
+        bool frameReady = false;
+    };
+
+    // Draws the output spectrum and a few seconds of the output level, which shows the
+    // echoes decaying (or building up when the feedback runs away).
+    class SpectrumAnalyser : public juce::Component, juce::Timer
+    {
+    public:
+        explicit SpectrumAnalyser(AnalyserFifo& fifo) : analyserThread(fifo)
+        {
+            frame.spectrum.fill(AnalyserThread::minDecibels);
+            frame.envelope.fill(AnalyserThread::minDecibels);
+            startTimerHz(refreshRate);
+        }
+
+        void paint(juce::Graphics& g) override
+        {
+            const auto bounds = getLocalBounds().toFloat();
+            g.setColour(juce::Colours::black);
+            g.fillRoundedRectangle(bounds, 4.f);
+
+            g.setColour(juce::Colours::orange.withAlpha(0.8f));
+            g.strokePath(makePath(frame.envelope.data(), (int)frame.envelope.size(), bounds), juce::PathStrokeType(1.f));
+
+            g.setColour(juce::Colour(0u, 172u, 1u));
+            g.strokePath(makePath(frame.spectrum.data(), (int)frame.spectrum.size(), bounds), juce::PathStrokeType(1.5f));
+        }
+
+        void timerCallback() override
+        {
+            adaptRefreshRate();
+
+            if (analyserThread.getLatestFrame(frame))
+                repaint();
+
+            analyserThread.requestFrame();
+        }
+
+    private:
+        static juce::Path makePath(const float* decibels, int numPoints, juce::Rectangle<float> bounds)
+        {
+            juce::Path p;
+
+            for (auto i = 0; i < numPoints; ++i)
+            {
+                const auto x = juce::jmap((float)i, 0.f, (float)(numPoints - 1), bounds.getX(), bounds.getRight());
+                const auto y = juce::jmap(decibels[i], AnalyserThread::minDecibels, 0.f, bounds.getBottom(), bounds.getY());
+
+                if (i == 0)
+                    p.startNewSubPath(x, y);
+                else
+                    p.lineTo(x, y);
+            }
+
+            return p;
+        }
+
+        // When the message thread is busy the timer fires late. Back off while that
+        // happens and creep back up once callbacks arrive on time again.
+        void adaptRefreshRate()
+        {
+            const auto now = juce::Time::getMillisecondCounterHiRes();
+            const auto elapsed = now - lastCallbackTime;
+            lastCallbackTime = now;
+
+            const auto expected = 1000.0 / refreshRate;
+            auto newRate = refreshRate;
+
+            if (elapsed > expected * 1.5)
+                newRate = juce::jmax(minRefreshRate, refreshRate - 5);
+            else if (elapsed < expected * 1.1)
+                newRate = juce::jmin(maxRefreshRate, refreshRate + 1);
+
+            if (newRate != refreshRate)
+            {
+                refreshRate = newRate;
+                startTimerHz(refreshRate);
+            }
+        }
+
+        static constexpr int minRefreshRate = 5;
+        static constexpr int maxRefreshRate = 30;
+
+        AnalyserThread analyserThread;
+        AnalyserThread::Frame frame;
+        int refreshRate = maxRefreshRate;
+        double lastCallbackTime = 0.0;
+    };
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+//==============================================================================
+// Layout of the POSIX shared-memory segment every DubEcho instance a user runs
+// publishes its stats to. It only uses plain C++ so the reader tool can include it
+// without JUCE. Bump version whenever anything below changes.
+namespace Telemetry
+{
+    // Each user gets a segment of their own, created readable and writable by them
+    // alone, so other users can neither read the stats nor plant a segment to be
+    // written to. Instances and readers only use a segment their user owns.
+    struct SegmentName
+    {
+        char text[40];
+    };
+
+    inline SegmentName getSegmentName(uint32_t userId) noexcept
+    {
+        SegmentName name;
+        std::snprintf(name.text, sizeof(name.text), "/dubecho-telemetry-%u", (unsigned)userId);
+        return name;
+    }
+
+    // Setting this to 0 in the environment, as a host can for the plugins it loads,
+    // stops instances publishing anything
+    constexpr const char* disableVariable = "DUBECHO_TELEMETRY";
+
+    constexpr uint32_t magic = 0x45425544;   // "DUBE"
+    constexpr uint32_t version = 2;
+
+    // Enough for a large session's instances across every host process the user runs,
+    // in a segment of about 400 KB. Instances that find every slot taken count
+    // themselves in droppedRegistrations and run unpublished.
+    constexpr uint32_t numSlots = 4096;
+
+    enum Flags : uint32_t
+    {
+        doublePrecision = 1 << 0,
+        delayFrozen     = 1 << 1,
+        reverbFrozen    = 1 << 2,
+        outputSilent    = 1 << 3,
+    };
+
+    struct Stats
+    {
+        uint64_t updateTimeNs;      // CLOCK_MONOTONIC at the end of the last block
+        uint64_t blocksProcessed;
+        uint64_t deadlineMisses;    // blocks that took longer to process than to play
+        double sampleRate;
+        uint32_t blockSize;         // of the last block
+        uint32_t qualityTier;       // QualityGovernor::Tier
+        uint32_t flags;
+        float lastBlockLoad;        // processing time over block duration
+        float smoothedLoad;
+        float rmsLeft, rmsRight;    // dBFS
+        float delayTime, delayFeedback, delayWet;
+        float reverbSize, reverbDamping, reverbWet;
+    };
+
+    // Each slot has a single writer, the audio thread of the instance that claimed it,
+    // so writing never waits. Readers retry when they catch a write in progress.
+    struct Slot
+    {
+        std::atomic<int32_t> ownerPid;      // 0 while the slot is free
+        std::atomic<uint32_t> sequence;     // odd while the stats are being written
+        uint32_t instanceId;
+        Stats stats;
+    };
+
+    struct Segment
+    {
+        std::atomic<uint32_t> magic;
+        uint32_t version, numSlots, slotSize;
+        std::atomic<uint32_t> nextInstanceId;
+        std::atomic<uint32_t> droppedRegistrations;     // opens that found every slot taken
+        Slot slots[Telemetry::numSlots];
+    };
+
+    static_assert(std::atomic<int32_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+                  "The slot header atomics are shared between processes");
+
+    //==============================================================================
+    inline void writeStats(Slot& slot, const Stats& stats) noexcept
+    {
+        const auto sequence = slot.sequence.load(std::memory_order_relaxed);
+        slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&slot.stats, &stats, sizeof(Stats));
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Returns false if the writer was part way through, in which case try again
+    inline bool readStats(const Slot& slot, Stats& dest) noexcept
+    {
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+
+        if ((sequence & 1) != 0)
+            return false;
+
+        std::memcpy(&dest, &slot.stats, sizeof(Stats));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.sequence.load(std::memory_order_relaxed) == sequence;
+    }
+}
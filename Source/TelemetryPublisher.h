@@ -0,0 +1,186 @@
+#pragma once
+#include <JuceHeader.h>
+#include "TelemetryLayout.h"
+
+// Set DUBECHO_TELEMETRY to 0 to build without publishing, or set the environment
+// variable of the same name to 0 to turn it off when the plugin is loaded
+#ifndef DUBECHO_TELEMETRY
+ #define DUBECHO_TELEMETRY 1
+#endif
+
+#if (JUCE_LINUX || JUCE_MAC) && DUBECHO_TELEMETRY
+ #include <cerrno>
+ #include <fcntl.h>
+ #include <signal.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <time.h>
+ #include <unistd.h>
+
+//==============================================================================
+// The mapping of the telemetry segment, shared by all instances in the process
+// through a SharedResourcePointer. The segment is never unlinked, since instances
+// in other processes may still be publishing to it.
+class TelemetrySegment
+{
+public:
+    TelemetrySegment()
+    {
+        if (juce::SystemStats::getEnvironmentVariable(Telemetry::disableVariable, {}).trim() == "0")
+            return;
+
+        const auto userId = geteuid();
+        const auto fd = shm_open(Telemetry::getSegmentName((uint32_t)userId).text, O_RDWR | O_CREAT, 0600);
+
+        if (fd < 0)
+            return;
+
+        // A segment someone else made, or opened up to others, is left alone. Growing
+        // a new segment zero-fills it, so every slot starts out free.
+        struct stat info;
+
+        if (fstat(fd, &info) != 0 || info.st_uid != userId || (info.st_mode & (S_IRWXG | S_IRWXO)) != 0
+         || (info.st_size < (off_t)sizeof(Telemetry::Segment) && ftruncate(fd, sizeof(Telemetry::Segment)) != 0))
+        {
+            close(fd);
+            return;
+        }
+
+        auto* mapping = mmap(nullptr, sizeof(Telemetry::Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+
+        if (mapping == MAP_FAILED)
+            return;
+
+        segment = static_cast<Telemetry::Segment*>(mapping);
+
+        if (segment->magic.load() == 0)
+        {
+            segment->version = Telemetry::version;
+            segment->numSlots = Telemetry::numSlots;
+            segment->slotSize = sizeof(Telemetry::Slot);
+            segment->magic.store(Telemetry::magic);
+        }
+
+        // Left behind by a build with a different layout
+        if (segment->magic.load() != Telemetry::magic || segment->version != Telemetry::version)
+        {
+            munmap(segment, sizeof(Telemetry::Segment));
+            segment = nullptr;
+        }
+    }
+
+    ~TelemetrySegment()
+    {
+        if (segment != nullptr)
+            munmap(segment, sizeof(Telemetry::Segment));
+    }
+
+    Telemetry::Segment* get() const noexcept
+    {
+        return segment;
+    }
+
+private:
+    Telemetry::Segment* segment{ nullptr };
+};
+
+//==============================================================================
+// Claims a slot in the telemetry segment for one plugin instance and writes its
+// stats there. The segment is mapped and the slot claimed in open, from prepareToPlay,
+// so creating an instance costs nothing here. Opening and closing happen on the
+// message thread; publish is wait-free and called from the audio thread.
+class TelemetryPublisher
+{
+public:
+    TelemetryPublisher() = default;
+
+    ~TelemetryPublisher()
+    {
+        close();
+    }
+
+    void open()
+    {
+        if (slot != nullptr)
+            return;
+
+        if (sharedSegment == nullptr)
+            sharedSegment = std::make_unique<juce::SharedResourcePointer<TelemetrySegment>>();
+
+        auto* segment = (*sharedSegment)->get();
+
+        if (segment == nullptr)
+            return;
+
+        const auto pid = (int32_t)getpid();
+
+        // A free slot first, then one whose owner has exited without releasing it
+        for (auto pass = 0; pass < 2 && slot == nullptr; ++pass)
+        {
+            for (auto& candidate : segment->slots)
+            {
+                auto owner = candidate.ownerPid.load();
+                const auto isAvailable = pass == 0 ? owner == 0 : (owner != 0 && kill(owner, 0) != 0 && errno == ESRCH);
+
+                if (isAvailable && candidate.ownerPid.compare_exchange_strong(owner, pid))
+                {
+                    // A previous owner may have died part way through a write
+                    slot = &candidate;
+                    slot->sequence.store((slot->sequence.load() + 1) & ~1u);
+                    slot->instanceId = segment->nextInstanceId.fetch_add(1) + 1;
+                    break;
+                }
+            }
+        }
+
+        // The instance runs unpublished, and the reader says how many did
+        if (slot == nullptr)
+            segment->droppedRegistrations.fetch_add(1);
+    }
+
+    // Gives the slot back, keeping the mapping for the next open
+    void close()
+    {
+        if (slot != nullptr)
+            slot->ownerPid.store(0);
+
+        slot = nullptr;
+    }
+
+    bool isActive() const noexcept
+    {
+        return slot != nullptr;
+    }
+
+    void publish(Telemetry::Stats& stats) noexcept
+    {
+        if (slot == nullptr)
+            return;
+
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        stats.updateTimeNs = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+
+        Telemetry::writeStats(*slot, stats);
+    }
+
+private:
+    std::unique_ptr<juce::SharedResourcePointer<TelemetrySegment>> sharedSegment;
+    Telemetry::Slot* slot{ nullptr };
+
+    JUCE_DECLARE_NON_COPYABLE(TelemetryPublisher)
+};
+
+#else
+//==============================================================================
+// No POSIX shared memory here, or publishing was built out, so nothing gets published
+class TelemetryPublisher
+{
+public:
+    void open() {}
+    void close() {}
+    bool isActive() const noexcept { return false; }
+    void publish(Telemetry::Stats&) noexcept {}
+};
+#endif
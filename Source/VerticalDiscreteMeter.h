@@ -38,6 +38,7 @@ namespace GUI
         }
 
         void setState(const bool state) { isOn = state; }
+        void setColour(const juce::Colour& c) { colour = c; }
 
     private:
         bool isOn = false;
@@ -48,6 +49,13 @@ namespace GUI
     public:
         VerticalDiscreteMeter(std::function<float()>&& valueFunction) : valueSupplier(std::move(valueFunction))
         {
+            for (auto i = 0; i < totalNoBulbs; i++)
+            {
+                auto bulb = std::make_unique<Bulb>(juce::Colours::black);
+                addAndMakeVisible(bulb.get());
+                bulbs.push_back(std::move(bulb));
+            }
+
             startTimerHz(24);
         }
 
@@ -78,14 +86,11 @@ namespace GUI
 
             auto bulbBounds = getLocalBounds();
             const auto bulbHeight = bulbBounds.getHeight() / totalNoBulbs;
-            bulbs.clear();
     
             for (auto i = 0; i < totalNoBulbs; i++)
             {
-                auto bulb = std::make_unique<Bulb>(gradient.getColourAtPosition(static_cast<double>(i) / totalNoBulbs));
-                addAndMakeVisible(bulb.get());
-                bulb->setBounds(bulbBounds.removeFromBottom(bulbHeight));
-                bulbs.push_back(std::move(bulb));
+                bulbs[i]->setColour(gradient.getColourAtPosition(static_cast<double>(i) / totalNoBulbs));
+                bulbs[i]->setBounds(bulbBounds.removeFromBottom(bulbHeight));
             }
 
         }
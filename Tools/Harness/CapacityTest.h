@@ -0,0 +1,289 @@
+#pragma once
+#include <JuceHeader.h>
+#include "HarnessInstance.h"
+
+namespace Harness
+{
+    //==============================================================================
+    // The threads of a host's audio engine. Each callback, run hands the instances
+    // out one at a time to whichever thread is free, the calling thread included,
+    // and returns once they have all been processed.
+    class WorkerPool
+    {
+    public:
+        WorkerPool(int numThreads, std::function<void(int)> jobToRun) : job(std::move(jobToRun))
+        {
+            for (auto i = 1; i < numThreads; ++i)
+                workers.add(new Worker(*this, i));
+
+            for (auto* worker : workers)
+                worker->startThread();
+        }
+
+        ~WorkerPool()
+        {
+            for (auto* worker : workers)
+                worker->signalThreadShouldExit();
+
+            for (auto* worker : workers)
+            {
+                worker->wakeUp.signal();
+                worker->stopThread(-1);
+            }
+        }
+
+        void run(int numJobsToRun) noexcept
+        {
+            // The new generation starts with every job taken, so nothing is claimed
+            // against the count until it is set
+            nextJob.store((++generation << 32) | noJobsLeft, std::memory_order_release);
+            numJobs = numJobsToRun;
+            numFinished.store(0);
+            nextJob.store(generation << 32, std::memory_order_release);
+
+            for (auto* worker : workers)
+                worker->wakeUp.signal();
+
+            runJobs();
+
+            while (numFinished.load(std::memory_order_acquire) < numJobs)
+                juce::Thread::yield();
+        }
+
+    private:
+        class Worker : public juce::Thread
+        {
+        public:
+            Worker(WorkerPool& poolToUse, int index)
+                : juce::Thread("DubEcho Harness Worker " + juce::String(index)), pool(poolToUse)
+            {
+            }
+
+            void run() override
+            {
+                for (;;)
+                {
+                    wakeUp.wait(-1);
+
+                    if (threadShouldExit())
+                        return;
+
+                    pool.runJobs();
+                }
+            }
+
+            juce::WaitableEvent wakeUp;
+
+        private:
+            WorkerPool& pool;
+        };
+
+        std::function<void(int)> job;
+        juce::OwnedArray<Worker> workers;
+        std::atomic<int> numJobs{ 0 }, numFinished{ 0 };
+
+        // The run's generation in the top half and the next job's index in the bottom,
+        // so a job can only be claimed from the run it belongs to
+        std::atomic<juce::uint64> nextJob{ 0 };
+        juce::uint64 generation{ 0 };
+        static constexpr juce::uint64 noJobsLeft = 0x7fffffff;
+
+        // A thread that wakes late finds every job taken and goes back to sleep. One
+        // still in here when the next run starts can't claim a job of the last run
+        // against the new count: its claim fails once the generation has moved on.
+        void runJobs() noexcept
+        {
+            auto claim = nextJob.load(std::memory_order_acquire);
+
+            for (;;)
+            {
+                const auto index = (int)(claim & noJobsLeft);
+
+                if (index >= numJobs.load(std::memory_order_acquire))
+                    return;
+
+                if (! nextJob.compare_exchange_weak(claim, claim + 1, std::memory_order_acq_rel))
+                    continue;
+
+                job(index);
+                numFinished.fetch_add(1, std::memory_order_release);
+                claim = nextJob.load(std::memory_order_acquire);
+            }
+        }
+    };
+
+    //==============================================================================
+    // What one run of the callback clock measured
+    struct RunResult
+    {
+        juce::uint64 callbacks{ 0 }, deadlineMisses{ 0 };
+        LatencyHistogram graphLatencies;        // all the instances, per callback
+        double lateness{ 0.0 };                 // worst overrun past a deadline, in seconds
+        int instancesInEconomy{ 0 };
+
+        double getMissRate() const noexcept
+        {
+            return callbacks > 0 ? (double)deadlineMisses / (double)callbacks : 0.0;
+        }
+    };
+
+    //==============================================================================
+    // Drives the first numActive of a set of instances from a WorkerPool on a clock
+    // that ticks like an audio device: every block is due one block's duration after
+    // the previous one, whatever the host made of it. A callback that finishes after
+    // its block was due is a deadline miss; one that runs past the next block too is
+    // a dropout, after which the clock restarts from now, as a device would.
+    class CapacityTest
+    {
+    public:
+        CapacityTest(const Setup& setupToUse, int numWorkers)
+            : setup(setupToUse), signal(setup.sampleRate),
+              pool(numWorkers, [this](int index) { instances.getUnchecked(index)->process(blockSize, songTime); })
+        {
+        }
+
+        ~CapacityTest()
+        {
+            callOnMessageThread([this] { instances.clear(); });
+        }
+
+        // Creates instances up to the number asked for, and prepares every active one
+        void setNumActive(int numInstances)
+        {
+            callOnMessageThread([this, numInstances]
+            {
+                while (instances.size() < numInstances)
+                    instances.add(new Instance(instances.size(), setup, signal));
+
+                for (auto i = 0; i < instances.size(); ++i)
+                {
+                    if (i < numInstances)
+                        instances.getUnchecked(i)->prepare();
+                    else if (i < numActive)
+                        instances.getUnchecked(i)->release();
+                }
+            });
+
+            numActive = numInstances;
+        }
+
+        int getNumActive() const noexcept
+        {
+            return numActive;
+        }
+
+        const Instance& getInstance(int index) const noexcept
+        {
+            return *instances.getUnchecked(index);
+        }
+
+        //==============================================================================
+        // Runs the clock for the given time, calling report every reportInterval
+        // seconds of it with the figures so far, while no callback is running
+        RunResult run(double seconds, double reportInterval = 0.0,
+                      std::function<void(double elapsed, const RunResult&)> report = {})
+        {
+            RunResult result;
+
+            for (auto i = 0; i < numActive; ++i)
+                instances.getUnchecked(i)->clearLatencies();
+
+            const auto startMs = juce::Time::getMillisecondCounterHiRes();
+            auto dueMs = startMs;
+            auto nextReport = reportInterval;
+
+            while (songTime - startSongTime < seconds)
+            {
+                blockSize = chooseBlockSize();
+                const auto blockMs = 1000.0 * blockSize / setup.sampleRate;
+
+                waitUntil(dueMs);
+
+                const auto callbackStart = juce::Time::getHighResolutionTicks();
+                pool.run(numActive);
+                const auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - callbackStart);
+
+                result.graphLatencies.add(elapsed);
+                ++result.callbacks;
+                songTime += blockSize / setup.sampleRate;
+
+                // The block had to be ready by the time the device wanted the next one
+                const auto nowMs = juce::Time::getMillisecondCounterHiRes();
+                const auto deadlineMs = dueMs + blockMs;
+
+                if (nowMs > deadlineMs)
+                {
+                    ++result.deadlineMisses;
+                    result.lateness = juce::jmax(result.lateness, (nowMs - deadlineMs) / 1000.0);
+                }
+
+                dueMs = nowMs > deadlineMs + blockMs ? nowMs : deadlineMs;
+
+                if (report != nullptr && reportInterval > 0.0 && songTime - startSongTime >= nextReport)
+                {
+                    report(songTime - startSongTime, result);
+                    nextReport += reportInterval;
+                }
+            }
+
+            startSongTime = songTime;
+
+            for (auto i = 0; i < numActive; ++i)
+                if (instances.getUnchecked(i)->getProcessor().getQualityTier() != QualityGovernor::high)
+                    ++result.instancesInEconomy;
+
+            return result;
+        }
+
+        // Every active instance's latencies, merged
+        LatencyHistogram getInstanceLatencies() const noexcept
+        {
+            LatencyHistogram merged;
+
+            for (auto i = 0; i < numActive; ++i)
+                merged.merge(instances.getUnchecked(i)->getLatencies());
+
+            return merged;
+        }
+
+    private:
+        const Setup& setup;
+        TestSignal signal;
+        juce::OwnedArray<Instance> instances;
+        int numActive{ 0 };
+        juce::Random random{ 0x434c4b };
+
+        // Read by the workers during a callback, written between callbacks
+        int blockSize{ 0 };
+        double songTime{ 0.0 }, startSongTime{ 0.0 };
+
+        WorkerPool pool;
+
+        // Most callbacks get the full block; jittered ones get anything down to a single
+        // sample, like hosts splitting blocks at loop points and automation events
+        int chooseBlockSize() noexcept
+        {
+            if (random.nextDouble() >= setup.blockJitter)
+                return setup.maxBlockSize;
+
+            return 1 + random.nextInt(setup.maxBlockSize);
+        }
+
+        // Sleeps most of the way and spins for the rest, since sleeps overshoot
+        static void waitUntil(double targetMs) noexcept
+        {
+            for (;;)
+            {
+                const auto remainingMs = targetMs - juce::Time::getMillisecondCounterHiRes();
+
+                if (remainingMs <= 0.0)
+                    return;
+
+                if (remainingMs > 2.0)
+                    juce::Thread::sleep((int)remainingMs - 1);
+                else
+                    juce::Thread::yield();
+            }
+        }
+    };
+}
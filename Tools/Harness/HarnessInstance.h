@@ -0,0 +1,208 @@
+#pragma once
+#include <JuceHeader.h>
+#include "../../Source/PluginProcessor.h"
+#include "HarnessUtilities.h"
+
+namespace Harness
+{
+    //==============================================================================
+    // What every instance is set up with, from the command line
+    struct Setup
+    {
+        double sampleRate{ 48000.0 };
+        int maxBlockSize{ 256 };
+        double blockJitter{ 0.1 };      // share of callbacks with a shorter block
+        bool doublePrecision{ false };
+        bool lockQuality{ false };
+        bool automate{ true };
+        int internalBlockSize{ 0 }, wetDecimation{ 1 };
+
+        // Called with 1 just before each processBlock and 0 just after, by the
+        // realtime check to arm its shim for exactly the plugin's own work
+        void (*aroundProcessBlock)(int isInside) { nullptr };
+    };
+
+    // The "Internal Block Size" settings an instance can be given: 0, or a size the
+    // plugin's parameter offers, which depends on how it was built
+    inline bool isValidInternalBlockSize(int numSamples)
+    {
+        return numSamples == 0 || DubEchoAudioProcessor::getInternalBlockSizes().contains(numSamples);
+    }
+
+    inline juce::String getInternalBlockSizeList()
+    {
+        juce::StringArray sizes;
+
+        for (auto size : DubEchoAudioProcessor::getInternalBlockSizes())
+            sizes.add(juce::String(size));
+
+        return sizes.joinIntoString(", ");
+    }
+
+    //==============================================================================
+    // One DubEchoAudioProcessor as a host would hold it: its own buffers, a varied
+    // starting preset and automation that keeps moving. Everything but processBlock
+    // is called the way a host calls it, from the message thread.
+    class Instance
+    {
+    public:
+        Instance(int indexToUse, const Setup& setupToUse, const TestSignal& signalToUse)
+            : index(indexToUse), setup(setupToUse), signal(signalToUse), random(0x1000 + indexToUse)
+        {
+            processor = std::make_unique<DubEchoAudioProcessor>();
+            auto& apvts = processor->apvts;
+
+            if (setup.doublePrecision)
+                processor->setProcessingPrecision(juce::AudioProcessor::doublePrecision);
+
+            // The tools check the setup against these before making any instances
+            const auto isSetUp = processor->setInternalBlockSize(setup.internalBlockSize)
+                                  && processor->setWetDecimation(setup.wetDecimation);
+            jassert(isSetUp);
+            juce::ignoreUnused(isSetUp);
+
+            // A spread of the presets a session would have: a quarter of the instances
+            // on the multiband delay and a third with the saturator oversampled
+            setParameter("Delay Time", 0.1f + 0.6f * random.nextFloat());
+            setParameter("Delay Feedback", 0.3f + 0.5f * random.nextFloat());
+            setParameter("Reverb Dry/Wet", 0.2f + 0.5f * random.nextFloat());
+            setChoice("Delay Bands", index % 4 == 3 ? 1 + random.nextInt(3) : 0);
+            setChoice("Saturation Oversampling", index % 3 == 2 ? 1 + random.nextInt(2) : 0);
+            setParameter("Quality Lock", setup.lockQuality ? 1.f : 0.f);
+
+            for (auto* id : { "Delay Time", "Delay Feedback", "Delay Dry/Wet", "Reverb Size", "Reverb Dry/Wet", "Duck Amount" })
+                automated.add(Automation{ apvts.getParameter(id), random.nextFloat() * juce::MathConstants<float>::twoPi,
+                                          5.f + 25.f * random.nextFloat() });
+
+            for (auto* id : { "Delay Bands", "Saturation Oversampling", "Delay Freeze", "Reverb Freeze" })
+                switched.add(apvts.getParameter(id));
+
+            signalPosition = random.nextInt(signal.getLength());
+        }
+
+        //==============================================================================
+        void prepare()
+        {
+            const auto numChannels = juce::jmax(processor->getTotalNumInputChannels(), processor->getTotalNumOutputChannels());
+
+            if (setup.doublePrecision)
+                doubleBuffer.setSize(numChannels, setup.maxBlockSize);
+            else
+                floatBuffer.setSize(numChannels, setup.maxBlockSize);
+
+            processor->setRateAndBufferSizeDetails(setup.sampleRate, setup.maxBlockSize);
+            processor->prepareToPlay(setup.sampleRate, setup.maxBlockSize);
+            nextSwitchTime = switchInterval * random.nextDouble();
+        }
+
+        void release()
+        {
+            processor->releaseResources();
+        }
+
+        //==============================================================================
+        // Called by whichever worker picks the instance up, with the song position of
+        // the block, so the automation moves with the clock rather than with the load
+        void process(int numSamples, double time) noexcept
+        {
+            if (setup.automate)
+                automate(time);
+
+            const auto startTicks = juce::Time::getHighResolutionTicks();
+
+            if (setup.doublePrecision)
+                processBuffer(doubleBuffer, numSamples);
+            else
+                processBuffer(floatBuffer, numSamples);
+
+            latencies.add(juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks));
+        }
+
+        //==============================================================================
+        int getIndex() const noexcept { return index; }
+        DubEchoAudioProcessor& getProcessor() noexcept { return *processor; }
+        const LatencyHistogram& getLatencies() const noexcept { return latencies; }
+        void clearLatencies() noexcept { latencies.clear(); }
+
+    private:
+        struct Automation
+        {
+            juce::RangedAudioParameter* parameter;
+            float phase, periodSeconds;
+        };
+
+        // Discrete parameters flip about this often, which also exercises the
+        // multiband line allocation and the saturator crossfade
+        static constexpr double switchInterval = 20.0;
+
+        const int index;
+        const Setup& setup;
+        const TestSignal& signal;
+        juce::Random random;
+
+        std::unique_ptr<DubEchoAudioProcessor> processor;
+        juce::AudioBuffer<float> floatBuffer;
+        juce::AudioBuffer<double> doubleBuffer;
+        juce::MidiBuffer midi;
+        int signalPosition{ 0 };
+
+        juce::Array<Automation> automated;
+        juce::Array<juce::RangedAudioParameter*> switched;
+        double nextSwitchTime{ 0.0 };
+        LatencyHistogram latencies;
+
+        void setParameter(const juce::String& id, float value)
+        {
+            if (auto* parameter = processor->apvts.getParameter(id))
+                parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+        }
+
+        void setChoice(const juce::String& id, int choice)
+        {
+            setParameter(id, (float)choice);
+        }
+
+        // The way plugin wrappers pass on automation, on the audio thread
+        static void setAutomatedValue(juce::RangedAudioParameter& parameter, float value) noexcept
+        {
+            parameter.setValue(value);
+            parameter.sendValueChangedMessageToListeners(value);
+        }
+
+        void automate(double time) noexcept
+        {
+            for (const auto& a : automated)
+            {
+                const auto angle = (float)(juce::MathConstants<double>::twoPi * time / a.periodSeconds) + a.phase;
+                setAutomatedValue(*a.parameter, 0.5f + 0.4f * std::sin(angle));
+            }
+
+            if (time < nextSwitchTime)
+                return;
+
+            auto& parameter = *switched.getUnchecked(random.nextInt(switched.size()));
+            const auto numSteps = juce::jmax(2, parameter.getNumSteps());
+            setAutomatedValue(parameter, (float)random.nextInt(numSteps) / (float)(numSteps - 1));
+            nextSwitchTime = time + switchInterval * (0.5 + random.nextDouble());
+        }
+
+        template <typename SampleType>
+        void processBuffer(juce::AudioBuffer<SampleType>& buffer, int numSamples) noexcept
+        {
+            // Refers to the instance's own channels, so nothing is allocated per block
+            juce::AudioBuffer<SampleType> block(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), numSamples);
+            block.clear();
+            signal.read(block, numSamples, signalPosition);
+
+            if (setup.aroundProcessBlock != nullptr)
+                setup.aroundProcessBlock(1);
+
+            processor->processBlock(block, midi);
+
+            if (setup.aroundProcessBlock != nullptr)
+                setup.aroundProcessBlock(0);
+        }
+
+        JUCE_DECLARE_NON_COPYABLE(Instance)
+    };
+}
@@ -0,0 +1,295 @@
+/*
+  ==============================================================================
+
+    Runs many DubEchoAudioProcessors the way a host would, to measure how many a
+    machine can sustain. Built by DubEchoHarness.jucer.
+
+        DubEchoHarness soak [options]      runs N instances for a while and reports
+                                           deadline misses, per-instance latency
+                                           percentiles and memory growth
+        DubEchoHarness search [options]    finds the most instances that run without
+                                           missing deadlines, per worker thread
+        DubEchoHarness instantiate [options]
+                                           times creating, restoring, preparing and
+                                           deleting instances as a session load does,
+                                           and the memory each step takes per instance
+
+    Options, as --name=value:
+
+        --instances     instances for soak and instantiate, 64 and 300 by default
+        --workers       audio threads, the processing cores for soak and 1 for search
+        --seconds       soak length, 60 by default; run for hours to see memory growth
+        --trial         seconds each search step runs for, 10 by default
+        --report        seconds between soak reports, 10 by default
+        --rate          sample rate, 48000 by default
+        --block         largest block size, 256 by default
+        --jitter        share of callbacks with a random shorter block, 0.1 by default
+        --max-miss-rate share of callbacks a search step may miss, 0 by default
+        --internal-block, --decimation
+                        the "Internal Block Size" and "Wet Decimation" settings:
+                        0 or one of the sizes the plugin offers, and 1, 2 or 4
+        --double        processes in double precision
+        --lock          holds the quality tier at high
+        --static        leaves the parameters alone instead of automating them
+        --per-instance  lists every instance's percentiles at the end of a soak
+
+    On Linux, run it under chrt -f 70 to give the threads realtime priority like a
+    host's audio threads.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "CapacityTest.h"
+#include "InstantiationBenchmark.h"
+
+namespace
+{
+    using namespace Harness;
+
+    int getIntOption(const juce::ArgumentList& args, const juce::String& option, int defaultValue)
+    {
+        const auto value = args.getValueForOption(option);
+        return value.isEmpty() ? defaultValue : value.getIntValue();
+    }
+
+    double getDoubleOption(const juce::ArgumentList& args, const juce::String& option, double defaultValue)
+    {
+        const auto value = args.getValueForOption(option);
+        return value.isEmpty() ? defaultValue : value.getDoubleValue();
+    }
+
+    Setup getSetup(const juce::ArgumentList& args)
+    {
+        Setup setup;
+        setup.sampleRate = getDoubleOption(args, "--rate", setup.sampleRate);
+        setup.maxBlockSize = getIntOption(args, "--block", setup.maxBlockSize);
+        setup.blockJitter = getDoubleOption(args, "--jitter", setup.blockJitter);
+        setup.internalBlockSize = getIntOption(args, "--internal-block", setup.internalBlockSize);
+        setup.wetDecimation = getIntOption(args, "--decimation", setup.wetDecimation);
+        setup.doublePrecision = args.containsOption("--double");
+        setup.lockQuality = args.containsOption("--lock");
+        setup.automate = ! args.containsOption("--static");
+
+        if (setup.sampleRate < 8000.0 || setup.maxBlockSize < 1 || setup.blockJitter < 0.0 || setup.blockJitter > 1.0)
+            juce::ConsoleApplication::fail("Invalid --rate, --block or --jitter");
+
+        if (setup.wetDecimation != 1 && setup.wetDecimation != 2 && setup.wetDecimation != 4)
+            juce::ConsoleApplication::fail("--decimation must be 1, 2 or 4");
+
+        if (! isValidInternalBlockSize(setup.internalBlockSize))
+            juce::ConsoleApplication::fail("--internal-block must be 0 or one of "
+                                           + getInternalBlockSizeList());
+
+        return setup;
+    }
+
+    juce::String formatMicroseconds(double seconds)
+    {
+        return juce::String(seconds * 1.0e6, 1) + " us";
+    }
+
+    //==============================================================================
+    int runSoak(const juce::ArgumentList& args)
+    {
+        const auto setup = getSetup(args);
+        const auto numInstances = getIntOption(args, "--instances", 64);
+        const auto numWorkers = getIntOption(args, "--workers", juce::SystemStats::getNumPhysicalCpus());
+        const auto seconds = getDoubleOption(args, "--seconds", 60.0);
+        const auto reportInterval = getDoubleOption(args, "--report", 10.0);
+        const auto perInstance = args.containsOption("--per-instance");
+        const auto periodSeconds = setup.maxBlockSize / setup.sampleRate;
+
+        if (numInstances < 1 || numWorkers < 1 || seconds <= 0.0)
+            juce::ConsoleApplication::fail("Invalid --instances, --workers or --seconds");
+
+        return runWithMessageThread([=]
+        {
+            CapacityTest test(setup, numWorkers);
+            test.setNumActive(numInstances);
+
+            std::cout << "Soak: " << numInstances << " instances on " << numWorkers << " threads, "
+                      << setup.sampleRate << " Hz, blocks of up to " << setup.maxBlockSize
+                      << " (" << formatMicroseconds(periodSeconds) << ")" << std::endl;
+
+            // Lines, reverbs and caches settle in the first seconds, so memory growth
+            // is counted from after them
+            test.run(2.0);
+            const auto startBytes = getResidentBytes();
+            std::cout << "Resident after warm-up: " << formatMegabytes(startBytes) << std::endl;
+
+            auto result = test.run(seconds, reportInterval, [&](double elapsed, const RunResult& soFar)
+            {
+                const auto instances = test.getInstanceLatencies();
+                const auto bytes = getResidentBytes();
+
+                std::cout << "[" << juce::String(elapsed, 0).paddedLeft(' ', 6) << " s]"
+                          << "  callbacks " << (juce::int64)soFar.callbacks
+                          << "  misses " << (juce::int64)soFar.deadlineMisses
+                          << " (" << juce::String(100.0 * soFar.getMissRate(), 3) << "%)"
+                          << "  callback p99 " << formatMicroseconds(soFar.graphLatencies.getPercentile(0.99))
+                          << "  instance p99 " << formatMicroseconds(instances.getPercentile(0.99))
+                          << " p999 " << formatMicroseconds(instances.getPercentile(0.999))
+                          << "  resident " << formatMegabytes(bytes)
+                          << " (" << (bytes >= startBytes ? "+" : "-") << formatMegabytes(std::abs(bytes - startBytes)) << ")"
+                          << std::endl;
+            });
+
+            const auto growth = getResidentBytes() - startBytes;
+
+            // Each instance's own percentiles, to find the outliers and the spread
+            juce::Array<double> p99s, p999s;
+
+            for (auto i = 0; i < numInstances; ++i)
+            {
+                const auto& latencies = test.getInstance(i).getLatencies();
+                p99s.add(latencies.getPercentile(0.99));
+                p999s.add(latencies.getPercentile(0.999));
+
+                if (perInstance)
+                    std::cout << "  instance " << juce::String(i).paddedLeft(' ', 4)
+                              << "  p99 " << formatMicroseconds(p99s.getLast())
+                              << "  p999 " << formatMicroseconds(p999s.getLast())
+                              << "  max " << formatMicroseconds(latencies.getMaximum()) << std::endl;
+            }
+
+            p99s.sort();
+            p999s.sort();
+
+            std::cout << std::endl
+                      << "Callbacks:       " << (juce::int64)result.callbacks << ", "
+                      << (juce::int64)result.deadlineMisses << " missed"
+                      << (result.deadlineMisses > 0 ? ", worst by " + formatMicroseconds(result.lateness) : juce::String()) << std::endl
+                      << "Callback time:   p99 " << formatMicroseconds(result.graphLatencies.getPercentile(0.99))
+                      << ", p999 " << formatMicroseconds(result.graphLatencies.getPercentile(0.999))
+                      << ", max " << formatMicroseconds(result.graphLatencies.getMaximum())
+                      << " of " << formatMicroseconds(periodSeconds) << std::endl
+                      << "Instance p99:    median " << formatMicroseconds(p99s[numInstances / 2])
+                      << ", worst " << formatMicroseconds(p99s.getLast()) << std::endl
+                      << "Instance p999:   median " << formatMicroseconds(p999s[numInstances / 2])
+                      << ", worst " << formatMicroseconds(p999s.getLast()) << std::endl
+                      << "Economy tier:    " << result.instancesInEconomy << " instances at the end" << std::endl
+                      << "Resident growth: " << formatMegabytes(growth)
+                      << ", " << formatMegabytes((juce::int64)((double)growth * 3600.0 / seconds)) << " per hour" << std::endl;
+
+            return result.deadlineMisses > 0 ? 1 : 0;
+        });
+    }
+
+    //==============================================================================
+    int runSearch(const juce::ArgumentList& args)
+    {
+        const auto setup = getSetup(args);
+        const auto numWorkers = getIntOption(args, "--workers", 1);
+        const auto trialSeconds = getDoubleOption(args, "--trial", 10.0);
+        const auto maxMissRate = getDoubleOption(args, "--max-miss-rate", 0.0);
+        constexpr auto maxInstances = 8192;
+
+        if (numWorkers < 1 || trialSeconds <= 0.0)
+            juce::ConsoleApplication::fail("Invalid --workers or --trial");
+
+        return runWithMessageThread([=]
+        {
+            CapacityTest test(setup, numWorkers);
+
+            std::cout << "Search: " << numWorkers << " threads, " << setup.sampleRate << " Hz, blocks of up to "
+                      << setup.maxBlockSize << ", " << trialSeconds << " s per step" << std::endl;
+
+            auto passes = [&](int numInstances)
+            {
+                test.setNumActive(numInstances);
+                test.run(1.0);
+                const auto result = test.run(trialSeconds);
+                const auto passed = result.getMissRate() <= maxMissRate;
+
+                std::cout << juce::String(numInstances).paddedLeft(' ', 6) << " instances: "
+                          << (juce::int64)result.deadlineMisses << " of " << (juce::int64)result.callbacks << " missed"
+                          << ", callback p999 " << formatMicroseconds(result.graphLatencies.getPercentile(0.999))
+                          << ", " << result.instancesInEconomy << " in economy"
+                          << (passed ? "  pass" : "  fail") << std::endl;
+
+                return passed;
+            };
+
+            // Doubles until a step fails, then bisects down to within 2%
+            auto highestPass = 0, lowestFail = 0;
+
+            for (auto n = numWorkers; n <= maxInstances; n *= 2)
+            {
+                if (! passes(n))
+                {
+                    lowestFail = n;
+                    break;
+                }
+
+                highestPass = n;
+            }
+
+            if (lowestFail == 0)
+            {
+                std::cout << "Still passing at " << highestPass << " instances, stopped there" << std::endl;
+                lowestFail = highestPass + 1;
+            }
+
+            while (lowestFail - highestPass > juce::jmax(1, highestPass / 50))
+            {
+                const auto n = (highestPass + lowestFail) / 2;
+
+                if (passes(n))
+                    highestPass = n;
+                else
+                    lowestFail = n;
+            }
+
+            std::cout << std::endl << "Most instances without misses: " << highestPass << ", "
+                      << juce::String((double)highestPass / numWorkers, 1) << " per thread" << std::endl;
+
+            return highestPass > 0 ? 0 : 1;
+        });
+    }
+
+    //==============================================================================
+    int runInstantiate(const juce::ArgumentList& args)
+    {
+        const auto setup = getSetup(args);
+        const auto numInstances = getIntOption(args, "--instances", 300);
+
+        if (numInstances < 1)
+            juce::ConsoleApplication::fail("Invalid --instances");
+
+        return runWithMessageThread([=]
+        {
+            InstantiationBenchmark benchmark(numInstances, setup.sampleRate, setup.maxBlockSize, setup.doublePrecision);
+
+            std::cout << "Instantiate: " << numInstances << " instances, " << setup.sampleRate
+                      << " Hz, blocks of " << setup.maxBlockSize << std::endl;
+
+            for (const auto& step : benchmark.run())
+                std::cout << "  " << step.name.paddedRight(' ', 20)
+                          << juce::String(step.seconds * 1000.0, 1).paddedLeft(' ', 9) << " ms"
+                          << juce::String(numInstances / juce::jmax(1.0e-9, step.seconds), 0).paddedLeft(' ', 10) << " instances/s"
+                          << juce::String(step.bytesPerInstance / 1024.0, 1).paddedLeft(' ', 10) << " KB/instance"
+                          << "  resident " << formatMegabytes(step.residentBytes) << std::endl;
+
+            return 0;
+        });
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ConsoleApplication app;
+    app.addHelpCommand("--help|-h", "DubEcho harness", true);
+
+    app.addCommand({ "soak", "soak [options]", "Runs N instances on a callback clock and reports misses, latency and memory", {},
+                     [](const juce::ArgumentList& args) { if (runSoak(args) != 0) juce::ConsoleApplication::fail({}, 1); } });
+
+    app.addCommand({ "search", "search [options]", "Finds the most instances a number of threads sustains", {},
+                     [](const juce::ArgumentList& args) { if (runSearch(args) != 0) juce::ConsoleApplication::fail({}, 1); } });
+
+    app.addCommand({ "instantiate", "instantiate [options]", "Times loading a session of N instances and the memory it takes", {},
+                     [](const juce::ArgumentList& args) { if (runInstantiate(args) != 0) juce::ConsoleApplication::fail({}, 1); } });
+
+    return app.findAndRunCommand(argc, argv);
+}
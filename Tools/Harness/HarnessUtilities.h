@@ -0,0 +1,221 @@
+#pragma once
+#include <JuceHeader.h>
+
+#if JUCE_LINUX
+ #include <unistd.h>
+#elif JUCE_MAC
+ #include <mach/mach.h>
+#elif JUCE_WINDOWS
+ #include <windows.h>
+ #include <psapi.h>
+ #pragma comment (lib, "psapi.lib")
+#endif
+
+namespace Harness
+{
+    //==============================================================================
+    // Runs a function on the message thread and waits for it, for the setup a host
+    // does there: creating, preparing and releasing instances
+    template <typename Function>
+    void callOnMessageThread(Function&& function)
+    {
+        using FunctionType = std::remove_reference_t<Function>;
+
+        juce::MessageManager::getInstance()->callFunctionOnMessageThread([](void* f) -> void*
+        {
+            (*static_cast<FunctionType*>(f))();
+            return nullptr;
+        }, &function);
+    }
+
+    //==============================================================================
+    // Runs a test on a thread of its own while this one dispatches messages, so the
+    // processors' timers and the setup calls happen on a message thread as in a host
+    inline int runWithMessageThread(std::function<int()> test, const juce::String& threadName = "DubEcho Harness Clock")
+    {
+        const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+        struct TestThread : public juce::Thread
+        {
+            TestThread(std::function<int()> testToRun, const juce::String& name)
+                : juce::Thread(name), test(std::move(testToRun)) {}
+
+            void run() override
+            {
+                exitCode = test();
+                juce::MessageManager::getInstance()->stopDispatchLoop();
+            }
+
+            std::function<int()> test;
+            int exitCode{ 0 };
+        };
+
+        TestThread thread(std::move(test), threadName);
+        thread.startThread();
+        juce::MessageManager::getInstance()->runDispatchLoop();
+        thread.stopThread(-1);
+        return thread.exitCode;
+    }
+
+    //==============================================================================
+    // Resident set size of this process in bytes, or 0 where it can't be read
+    inline juce::int64 getResidentBytes()
+    {
+       #if JUCE_LINUX
+        juce::int64 totalPages = 0, residentPages = 0;
+
+        if (auto* statm = std::fopen("/proc/self/statm", "r"))
+        {
+            if (std::fscanf(statm, "%lld %lld", &totalPages, &residentPages) != 2)
+                residentPages = 0;
+
+            std::fclose(statm);
+        }
+
+        return residentPages * (juce::int64)sysconf(_SC_PAGESIZE);
+       #elif JUCE_MAC
+        mach_task_basic_info info;
+        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+
+        if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+            return 0;
+
+        return (juce::int64)info.resident_size;
+       #elif JUCE_WINDOWS
+        PROCESS_MEMORY_COUNTERS counters;
+
+        if (! GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return 0;
+
+        return (juce::int64)counters.WorkingSetSize;
+       #else
+        return 0;
+       #endif
+    }
+
+    inline juce::String formatMegabytes(juce::int64 bytes)
+    {
+        return juce::String((double)bytes / (1024.0 * 1024.0), 1) + " MB";
+    }
+
+    //==============================================================================
+    // Counts durations in buckets 5% wide from 100 ns up, so a run of hours keeps a
+    // fixed size and percentiles come out within a bucket of the exact figure.
+    // add is wait-free and allocation-free, for the threads being measured.
+    class LatencyHistogram
+    {
+    public:
+        void add(double seconds) noexcept
+        {
+            ++buckets[(size_t)getBucket(seconds)];
+            ++count;
+            maximum = juce::jmax(maximum, seconds);
+        }
+
+        void merge(const LatencyHistogram& other) noexcept
+        {
+            for (size_t i = 0; i < numBuckets; ++i)
+                buckets[i] += other.buckets[i];
+
+            count += other.count;
+            maximum = juce::jmax(maximum, other.maximum);
+        }
+
+        void clear() noexcept
+        {
+            buckets.fill(0);
+            count = 0;
+            maximum = 0.0;
+        }
+
+        juce::uint64 getCount() const noexcept { return count; }
+        double getMaximum() const noexcept { return maximum; }
+
+        // The upper edge of the bucket the given fraction of durations falls in
+        double getPercentile(double fraction) const noexcept
+        {
+            if (count == 0)
+                return 0.0;
+
+            const auto rank = (juce::uint64)std::ceil(fraction * (double)count);
+            juce::uint64 seen = 0;
+
+            for (size_t i = 0; i < numBuckets; ++i)
+            {
+                seen += buckets[i];
+
+                if (seen >= rank)
+                    return juce::jmin(maximum, getUpperEdge((int)i));
+            }
+
+            return maximum;
+        }
+
+    private:
+        static constexpr size_t numBuckets = 512;
+        static constexpr double smallest = 100.0e-9;
+        static constexpr double bucketsPerE = 20.0;   // e^(1/20) is 5% apart
+
+        std::array<juce::uint64, numBuckets> buckets{};
+        juce::uint64 count{ 0 };
+        double maximum{ 0.0 };
+
+        static int getBucket(double seconds) noexcept
+        {
+            if (seconds <= smallest)
+                return 0;
+
+            return juce::jlimit(0, (int)numBuckets - 1, (int)(std::log(seconds / smallest) * bucketsPerE));
+        }
+
+        static double getUpperEdge(int bucket) noexcept
+        {
+            return smallest * std::exp((bucket + 1) / bucketsPerE);
+        }
+    };
+
+    //==============================================================================
+    // A few seconds of noise bursts and silence, which every instance loops from its
+    // own offset, so the delays and reverbs always have a tail to work on and the
+    // instances don't all hit the same sample at once.
+    class TestSignal
+    {
+    public:
+        explicit TestSignal(double sampleRate)
+        {
+            const auto length = (int)(sampleRate * 4.0);
+            const auto burstLength = (int)(sampleRate * 0.15);
+            const auto burstSpacing = (int)(sampleRate * 0.7);
+            juce::Random random(0x44554245);
+
+            signal.setSize(2, length);
+            signal.clear();
+
+            for (auto start = 0; start + burstLength < length; start += burstSpacing)
+                for (auto i = 0; i < burstLength; ++i)
+                    for (auto ch = 0; ch < 2; ++ch)
+                        signal.setSample(ch, start + i, 0.5f * (1.f - (float)i / (float)burstLength) * (random.nextFloat() * 2.f - 1.f));
+        }
+
+        int getLength() const noexcept
+        {
+            return signal.getNumSamples();
+        }
+
+        // Fills the first two channels of dest from position onwards, wrapping round
+        template <typename SampleType>
+        void read(juce::AudioBuffer<SampleType>& dest, int numSamples, int& position) const noexcept
+        {
+            for (auto i = 0; i < numSamples; ++i)
+            {
+                for (auto ch = 0; ch < juce::jmin(2, dest.getNumChannels()); ++ch)
+                    dest.setSample(ch, i, (SampleType)signal.getSample(ch, position));
+
+                position = position + 1 == signal.getNumSamples() ? 0 : position + 1;
+            }
+        }
+
+    private:
+        juce::AudioBuffer<float> signal;
+    };
+}
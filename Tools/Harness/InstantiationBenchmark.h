@@ -0,0 +1,126 @@
+#pragma once
+#include <JuceHeader.h>
+#include "../../Source/PluginProcessor.h"
+#include "HarnessUtilities.h"
+
+namespace Harness
+{
+    //==============================================================================
+    // Goes through what a host does to every instance while loading a session, one
+    // step at a time across all of them, timing each step and measuring what it
+    // leaves resident. Every step runs on the message thread, as hosts run them.
+    class InstantiationBenchmark
+    {
+    public:
+        struct Step
+        {
+            juce::String name;
+            double seconds;
+            juce::int64 residentBytes;      // of the whole process after the step
+            juce::int64 bytesPerInstance;   // added by the step
+        };
+
+        InstantiationBenchmark(int numInstancesToUse, double sampleRateToUse, int blockSizeToUse, bool doublePrecisionToUse)
+            : numInstances(numInstancesToUse), sampleRate(sampleRateToUse),
+              blockSize(blockSizeToUse), doublePrecision(doublePrecisionToUse)
+        {
+        }
+
+        juce::Array<Step> run()
+        {
+            juce::Array<Step> steps;
+            juce::MemoryBlock session = makeSessionState();
+            const auto otherRate = sampleRate == 48000.0 ? 44100.0 : 48000.0;
+
+            residentBefore = getResidentBytes();
+
+            steps.add(measure("construct", [this]
+            {
+                for (auto i = 0; i < numInstances; ++i)
+                    processors.add(new DubEchoAudioProcessor());
+            }));
+
+            steps.add(measure("restore state", [this, &session]
+            {
+                for (auto* p : processors)
+                    p->setStateInformation(session.getData(), (int)session.getSize());
+            }));
+
+            steps.add(measure("prepare", [this] { prepareAll(sampleRate); }));
+            steps.add(measure("prepare again", [this] { prepareAll(sampleRate); }));
+            steps.add(measure("change rate", [this, otherRate] { prepareAll(otherRate); }));
+
+            steps.add(measure("release and delete", [this]
+            {
+                for (auto* p : processors)
+                    p->releaseResources();
+
+                processors.clear();
+            }));
+
+            return steps;
+        }
+
+        int getNumInstances() const noexcept
+        {
+            return numInstances;
+        }
+
+    private:
+        const int numInstances;
+        const double sampleRate;
+        const int blockSize;
+        const bool doublePrecision;
+        juce::OwnedArray<DubEchoAudioProcessor> processors;
+        juce::int64 residentBefore{ 0 }, residentLast{ 0 };
+
+        // A session's worth of state, saved by an instance set up like a typical one,
+        // with the multiband delay on so restoring it builds the lines at prepare
+        juce::MemoryBlock makeSessionState() const
+        {
+            juce::MemoryBlock state;
+
+            callOnMessageThread([&state]
+            {
+                DubEchoAudioProcessor source;
+
+                for (auto* id : { "Delay Bands", "Saturation Oversampling", "Delay Feedback", "Reverb Size" })
+                    if (auto* parameter = source.apvts.getParameter(id))
+                        parameter->setValueNotifyingHost(0.6f);
+
+                source.getStateInformation(state);
+            });
+
+            return state;
+        }
+
+        void prepareAll(double rate)
+        {
+            for (auto* p : processors)
+            {
+                if (doublePrecision)
+                    p->setProcessingPrecision(juce::AudioProcessor::doublePrecision);
+
+                p->setRateAndBufferSizeDetails(rate, blockSize);
+                p->prepareToPlay(rate, blockSize);
+            }
+        }
+
+        template <typename Function>
+        Step measure(const juce::String& name, Function&& function)
+        {
+            if (residentLast == 0)
+                residentLast = residentBefore;
+
+            const auto startTicks = juce::Time::getHighResolutionTicks();
+            callOnMessageThread(function);
+            const auto seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+            const auto resident = getResidentBytes();
+            const auto added = (resident - residentLast) / numInstances;
+            residentLast = resident;
+
+            return { name, seconds, resident, added };
+        }
+    };
+}
@@ -0,0 +1,208 @@
+/*
+  ==============================================================================
+
+    Checks that DubEchoAudioProcessor::processBlock never allocates, locks or
+    makes a blocking system call, however the host drives it. Built by
+    DubEchoRealtimeCheck.jucer, and run with the shim in RealtimeShim.cpp
+    preloaded, which does the catching:
+
+        LD_PRELOAD=./libdubecho-rtcheck.so DubEchoRealtimeCheck [options]
+
+    Each cycle creates an instance on the message thread, then goes round
+    prepare, process, release a few times at different rates and block sizes,
+    with the parameters automated from the audio thread and whole states
+    loaded from the message thread while it processes. Cycles step through
+    the precisions, "Internal Block Size" and "Wet Decimation" settings.
+
+    The shim is armed only around processBlock on the audio thread, and stops
+    the run with a backtrace at the first violation.
+
+    Options, as --name=value:
+
+        --cycles        instances to go through, 24 by default
+        --seconds       seconds of audio per prepare, 30 by default; processed
+                        as fast as the machine allows, not in real time
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../Harness/HarnessInstance.h"
+
+#if JUCE_LINUX
+ #include <dlfcn.h>
+#endif
+
+namespace
+{
+    using namespace Harness;
+
+    using ArmFunction = void (*)(int);
+    using ViolationsFunction = long (*)();
+
+    // One configuration a cycle runs through, and the rates and block sizes it is
+    // prepared with in turn, as a host does when the audio settings change
+    struct Configuration
+    {
+        bool doublePrecision;
+        int internalBlockSize, wetDecimation;
+    };
+
+    constexpr Configuration configurations[] = {
+        { false, 0, 1 }, { true, 0, 1 }, { false, 64, 1 }, { false, 0, 2 },
+        { true, 128, 4 }, { false, 64, 4 }
+    };
+
+    constexpr struct { double sampleRate; int blockSize; } preparations[] = {
+        { 48000.0, 256 }, { 44100.0, 1024 }, { 96000.0, 32 }, { 48000.0, 480 }
+    };
+
+    // Seconds of audio between state loads, which switch the bands and oversampling
+    // far more often than the automation alone does
+    constexpr double stateLoadInterval = 0.5;
+
+    //==============================================================================
+    // Saved states of instances started from different presets, to load into others
+    juce::Array<juce::MemoryBlock> makeStates(const Setup& setup, const TestSignal& signal)
+    {
+        juce::Array<juce::MemoryBlock> states;
+
+        callOnMessageThread([&]
+        {
+            for (auto i = 0; i < 6; ++i)
+            {
+                Instance source(i, setup, signal);
+                juce::MemoryBlock state;
+                source.getProcessor().getStateInformation(state);
+                states.add(state);
+            }
+        });
+
+        return states;
+    }
+
+    // Blocks of the prepared size, with every fourth one shorter as hosts send
+    // around loop points and tempo changes
+    void processFor(Instance& instance, const Setup& setup, double seconds,
+                    const juce::Array<juce::MemoryBlock>& states, juce::Random& random)
+    {
+        auto time = 0.0, nextStateLoad = stateLoadInterval;
+
+        while (time < seconds)
+        {
+            const auto numSamples = random.nextInt(4) == 0 ? 1 + random.nextInt(setup.maxBlockSize)
+                                                           : setup.maxBlockSize;
+            instance.process(numSamples, time);
+            time += numSamples / setup.sampleRate;
+
+            // Posted rather than waited for, so the load can land mid-block
+            if (time >= nextStateLoad)
+            {
+                auto* processor = &instance.getProcessor();
+                const auto state = states[random.nextInt(states.size())];
+
+                juce::MessageManager::callAsync([processor, state]
+                {
+                    processor->setStateInformation(state.getData(), (int)state.getSize());
+                });
+
+                nextStateLoad = time + stateLoadInterval;
+            }
+        }
+    }
+
+    //==============================================================================
+    int runCheck(const juce::ArgumentList& args, ArmFunction arm, ViolationsFunction getViolations)
+    {
+        const auto cyclesValue = args.getValueForOption("--cycles");
+        const auto secondsValue = args.getValueForOption("--seconds");
+        const auto numCycles = cyclesValue.isEmpty() ? 24 : cyclesValue.getIntValue();
+        const auto seconds = secondsValue.isEmpty() ? 30.0 : secondsValue.getDoubleValue();
+
+        if (numCycles < 1 || seconds <= 0.0)
+            juce::ConsoleApplication::fail("Invalid --cycles or --seconds");
+
+        // A setting the plugin doesn't offer would leave the instance on its default
+        for (const auto& configuration : configurations)
+            if (! isValidInternalBlockSize(configuration.internalBlockSize))
+                juce::ConsoleApplication::fail("Internal block size " + juce::String(configuration.internalBlockSize)
+                                               + " isn't one of " + getInternalBlockSizeList());
+
+        return runWithMessageThread([=]
+        {
+            juce::Random random(0x52544348);
+
+            for (auto cycle = 0; cycle < numCycles; ++cycle)
+            {
+                const auto& configuration = configurations[(size_t)cycle % std::size(configurations)];
+
+                Setup setup;
+                setup.doublePrecision = configuration.doublePrecision;
+                setup.internalBlockSize = configuration.internalBlockSize;
+                setup.wetDecimation = configuration.wetDecimation;
+                setup.aroundProcessBlock = arm;
+
+                const TestSignal signal(setup.sampleRate);
+                const auto states = makeStates(setup, signal);
+                std::unique_ptr<Instance> instance;
+
+                std::cout << "Cycle " << cycle + 1 << " of " << numCycles << ": "
+                          << (setup.doublePrecision ? "double" : "float")
+                          << ", internal block " << setup.internalBlockSize
+                          << ", decimation " << setup.wetDecimation << std::endl;
+
+                callOnMessageThread([&] { instance = std::make_unique<Instance>(cycle, setup, signal); });
+
+                for (const auto& preparation : preparations)
+                {
+                    // The instance reads the setup when it prepares, so it changes
+                    // here, while nothing is processing
+                    callOnMessageThread([&]
+                    {
+                        setup.sampleRate = preparation.sampleRate;
+                        setup.maxBlockSize = preparation.blockSize;
+                        instance->prepare();
+                    });
+
+                    processFor(*instance, setup, seconds, states, random);
+                    callOnMessageThread([&] { instance->release(); });
+                }
+
+                // Runs after any state loads still queued, which hold the processor
+                callOnMessageThread([&] { instance.reset(); });
+            }
+
+            const auto numViolations = getViolations();
+            std::cout << std::endl << numViolations << " realtime violations in " << numCycles << " cycles" << std::endl;
+            return numViolations > 0 ? 1 : 0;
+        }, "DubEcho Realtime Check Audio");
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ConsoleApplication app;
+    app.addHelpCommand("--help|-h", "DubEcho realtime check", true);
+
+    app.addDefaultCommand({ "", "[--cycles=N] [--seconds=S]",
+                            "Drives an instance through prepare, process, automation and state loads with the shim armed", {},
+                            [](const juce::ArgumentList& args)
+                            {
+                               #if JUCE_LINUX
+                                auto arm = reinterpret_cast<ArmFunction>(dlsym(RTLD_DEFAULT, "dubecho_rt_arm"));
+                                auto getViolations = reinterpret_cast<ViolationsFunction>(dlsym(RTLD_DEFAULT, "dubecho_rt_get_violations"));
+
+                                if (arm == nullptr || getViolations == nullptr)
+                                    juce::ConsoleApplication::fail("The realtime shim isn't loaded; run with LD_PRELOAD=libdubecho-rtcheck.so");
+
+                                if (runCheck(args, arm, getViolations) != 0)
+                                    juce::ConsoleApplication::fail({}, 1);
+                               #else
+                                juce::ignoreUnused(args);
+                                juce::ConsoleApplication::fail("The realtime check needs Linux, for LD_PRELOAD");
+                               #endif
+                            } });
+
+    return app.findAndRunCommand(argc, argv);
+}
@@ -0,0 +1,390 @@
+/*
+  ==============================================================================
+
+    Preloaded into DubEchoRealtimeCheck to catch the audio thread doing anything
+    that can block: allocating or freeing memory, taking a lock, or making one of
+    the system calls below. Plain POSIX C++, no JUCE, Linux only:
+
+        c++ -std=c++17 -O2 -shared -fPIC Tools/RealtimeCheck/RealtimeShim.cpp \
+            -o libdubecho-rtcheck.so -ldl
+
+        LD_PRELOAD=./libdubecho-rtcheck.so DubEchoRealtimeCheck
+
+    Nothing is checked until a thread calls dubecho_rt_arm(1), and then only on
+    that thread, until it calls dubecho_rt_arm(0). The first call made while armed
+    prints its name and a backtrace and aborts; with DUBECHO_RTCHECK_CONTINUE=1 in
+    the environment every one is printed and counted instead.
+
+    Calls made through syscall() directly, and page faults on memory that was
+    allocated earlier but never touched, are not seen.
+
+  ==============================================================================
+*/
+
+#ifndef _GNU_SOURCE
+ #define _GNU_SOURCE
+#endif
+
+#include <cerrno>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+extern "C"
+{
+    // glibc's own entry points, which the replacements below forward to without
+    // looking anything up, so they work before the shim is initialised
+    void* __libc_malloc(size_t);
+    void* __libc_calloc(size_t, size_t);
+    void* __libc_realloc(void*, size_t);
+    void* __libc_memalign(size_t, size_t);
+    void __libc_free(void*);
+}
+
+namespace
+{
+    // Initial-exec TLS lives in the thread's static block, so reading it never
+    // allocates, even on a thread's first call
+    __thread int armed __attribute__((tls_model("initial-exec"))) = 0;
+
+    bool continueAfterViolation = false;
+    volatile long numViolations = 0;
+
+    // Looked up once at load time; dlsym allocates, so never on an armed thread
+    struct RealFunctions
+    {
+        int (*pthread_mutex_lock)(pthread_mutex_t*);
+        int (*pthread_rwlock_rdlock)(pthread_rwlock_t*);
+        int (*pthread_rwlock_wrlock)(pthread_rwlock_t*);
+        int (*pthread_cond_wait)(pthread_cond_t*, pthread_mutex_t*);
+        int (*pthread_cond_timedwait)(pthread_cond_t*, pthread_mutex_t*, const timespec*);
+        int (*pthread_create)(pthread_t*, const pthread_attr_t*, void* (*)(void*), void*);
+        int (*sem_wait)(sem_t*);
+        int (*sem_timedwait)(sem_t*, const timespec*);
+        ssize_t (*read)(int, void*, size_t);
+        ssize_t (*write)(int, const void*, size_t);
+        int (*open)(const char*, int, ...);
+        int (*openat)(int, const char*, int, ...);
+        int (*close)(int);
+        int (*fsync)(int);
+        void* (*mmap)(void*, size_t, int, int, int, off_t);
+        int (*munmap)(void*, size_t);
+        int (*mprotect)(void*, size_t, int);
+        int (*nanosleep)(const timespec*, timespec*);
+        int (*clock_nanosleep)(clockid_t, int, const timespec*, timespec*);
+        int (*usleep)(useconds_t);
+        int (*sched_yield)();
+        int (*poll)(pollfd*, nfds_t, int);
+        int (*select)(int, fd_set*, fd_set*, fd_set*, timeval*);
+    };
+
+    RealFunctions real{};
+
+    template <typename Function>
+    void lookUp(Function& function, const char* name)
+    {
+        function = reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+    }
+
+    // Writes straight to the kernel, so reporting doesn't go back through the shim
+    void print(const char* text)
+    {
+        ::syscall(SYS_write, 2, text, std::strlen(text));
+    }
+
+    __attribute__((constructor)) void initialise()
+    {
+        lookUp(real.pthread_mutex_lock, "pthread_mutex_lock");
+        lookUp(real.pthread_rwlock_rdlock, "pthread_rwlock_rdlock");
+        lookUp(real.pthread_rwlock_wrlock, "pthread_rwlock_wrlock");
+        lookUp(real.pthread_cond_wait, "pthread_cond_wait");
+        lookUp(real.pthread_cond_timedwait, "pthread_cond_timedwait");
+        lookUp(real.pthread_create, "pthread_create");
+        lookUp(real.sem_wait, "sem_wait");
+        lookUp(real.sem_timedwait, "sem_timedwait");
+        lookUp(real.read, "read");
+        lookUp(real.write, "write");
+        lookUp(real.open, "open");
+        lookUp(real.openat, "openat");
+        lookUp(real.close, "close");
+        lookUp(real.fsync, "fsync");
+        lookUp(real.mmap, "mmap");
+        lookUp(real.munmap, "munmap");
+        lookUp(real.mprotect, "mprotect");
+        lookUp(real.nanosleep, "nanosleep");
+        lookUp(real.clock_nanosleep, "clock_nanosleep");
+        lookUp(real.usleep, "usleep");
+        lookUp(real.sched_yield, "sched_yield");
+        lookUp(real.poll, "poll");
+        lookUp(real.select, "select");
+
+        const auto* shouldContinue = std::getenv("DUBECHO_RTCHECK_CONTINUE");
+        continueAfterViolation = shouldContinue != nullptr && std::strcmp(shouldContinue, "0") != 0;
+
+        // The first backtrace loads the unwinder, which allocates, so get that over with
+        void* frames[4];
+        backtrace(frames, 4);
+    }
+
+    // Disarms while reporting, so the report's own calls pass straight through
+    void violation(const char* function)
+    {
+        armed = 0;
+        ++numViolations;
+
+        print("\n*** DubEcho realtime check: ");
+        print(function);
+        print(" called on the audio thread\n");
+
+        void* frames[64];
+        const auto numFrames = backtrace(frames, 64);
+        backtrace_symbols_fd(frames, numFrames, 2);
+
+        if (! continueAfterViolation)
+            std::abort();
+
+        armed = 1;
+    }
+
+    inline void check(const char* function)
+    {
+        if (armed != 0)
+            violation(function);
+    }
+}
+
+//==============================================================================
+extern "C"
+{
+    // Looked up with dlsym by the check, which refuses to run without the shim
+    __attribute__((visibility("default"))) void dubecho_rt_arm(int shouldBeArmed)
+    {
+        armed = shouldBeArmed != 0 ? 1 : 0;
+    }
+
+    __attribute__((visibility("default"))) long dubecho_rt_get_violations()
+    {
+        return numViolations;
+    }
+
+    //==============================================================================
+    void* malloc(size_t size)
+    {
+        check("malloc");
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        check("calloc");
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* pointer, size_t size)
+    {
+        check("realloc");
+        return __libc_realloc(pointer, size);
+    }
+
+    // Freeing nothing is allowed, since delete on a null pointer is common and free
+    void free(void* pointer)
+    {
+        if (pointer != nullptr)
+            check("free");
+
+        __libc_free(pointer);
+    }
+
+    void* memalign(size_t alignment, size_t size)
+    {
+        check("memalign");
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size)
+    {
+        check("aligned_alloc");
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** result, size_t alignment, size_t size)
+    {
+        check("posix_memalign");
+        *result = __libc_memalign(alignment, size);
+        return *result != nullptr ? 0 : ENOMEM;
+    }
+
+    //==============================================================================
+    int pthread_mutex_lock(pthread_mutex_t* mutex)
+    {
+        check("pthread_mutex_lock");
+        return real.pthread_mutex_lock(mutex);
+    }
+
+    int pthread_rwlock_rdlock(pthread_rwlock_t* lock)
+    {
+        check("pthread_rwlock_rdlock");
+        return real.pthread_rwlock_rdlock(lock);
+    }
+
+    int pthread_rwlock_wrlock(pthread_rwlock_t* lock)
+    {
+        check("pthread_rwlock_wrlock");
+        return real.pthread_rwlock_wrlock(lock);
+    }
+
+    int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex)
+    {
+        check("pthread_cond_wait");
+        return real.pthread_cond_wait(condition, mutex);
+    }
+
+    int pthread_cond_timedwait(pthread_cond_t* condition, pthread_mutex_t* mutex, const timespec* time)
+    {
+        check("pthread_cond_timedwait");
+        return real.pthread_cond_timedwait(condition, mutex, time);
+    }
+
+    int pthread_create(pthread_t* thread, const pthread_attr_t* attributes, void* (*function)(void*), void* argument)
+    {
+        check("pthread_create");
+        return real.pthread_create(thread, attributes, function, argument);
+    }
+
+    int sem_wait(sem_t* semaphore)
+    {
+        check("sem_wait");
+        return real.sem_wait(semaphore);
+    }
+
+    int sem_timedwait(sem_t* semaphore, const timespec* time)
+    {
+        check("sem_timedwait");
+        return real.sem_timedwait(semaphore, time);
+    }
+
+    //==============================================================================
+    ssize_t read(int fd, void* buffer, size_t size)
+    {
+        check("read");
+        return real.read(fd, buffer, size);
+    }
+
+    ssize_t write(int fd, const void* buffer, size_t size)
+    {
+        check("write");
+        return real.write(fd, buffer, size);
+    }
+
+    // The mode is only passed on when the flags say there is one
+    int open(const char* path, int flags, ...)
+    {
+        check("open");
+        mode_t mode = 0;
+
+        if ((flags & (O_CREAT | O_TMPFILE)) != 0)
+        {
+            va_list args;
+            va_start(args, flags);
+            mode = (mode_t)va_arg(args, int);
+            va_end(args);
+        }
+
+        return real.open(path, flags, mode);
+    }
+
+    int openat(int directory, const char* path, int flags, ...)
+    {
+        check("openat");
+        mode_t mode = 0;
+
+        if ((flags & (O_CREAT | O_TMPFILE)) != 0)
+        {
+            va_list args;
+            va_start(args, flags);
+            mode = (mode_t)va_arg(args, int);
+            va_end(args);
+        }
+
+        return real.openat(directory, path, flags, mode);
+    }
+
+    int close(int fd)
+    {
+        check("close");
+        return real.close(fd);
+    }
+
+    int fsync(int fd)
+    {
+        check("fsync");
+        return real.fsync(fd);
+    }
+
+    void* mmap(void* address, size_t length, int protection, int flags, int fd, off_t offset)
+    {
+        check("mmap");
+        return real.mmap(address, length, protection, flags, fd, offset);
+    }
+
+    int munmap(void* address, size_t length)
+    {
+        check("munmap");
+        return real.munmap(address, length);
+    }
+
+    int mprotect(void* address, size_t length, int protection)
+    {
+        check("mprotect");
+        return real.mprotect(address, length, protection);
+    }
+
+    int nanosleep(const timespec* duration, timespec* remaining)
+    {
+        check("nanosleep");
+        return real.nanosleep(duration, remaining);
+    }
+
+    int clock_nanosleep(clockid_t clock, int flags, const timespec* time, timespec* remaining)
+    {
+        check("clock_nanosleep");
+        return real.clock_nanosleep(clock, flags, time, remaining);
+    }
+
+    int usleep(useconds_t microseconds)
+    {
+        check("usleep");
+        return real.usleep(microseconds);
+    }
+
+    int sched_yield()
+    {
+        check("sched_yield");
+        return real.sched_yield();
+    }
+
+    int poll(pollfd* fds, nfds_t numFds, int timeout)
+    {
+        check("poll");
+        return real.poll(fds, numFds, timeout);
+    }
+
+    int select(int numFds, fd_set* readFds, fd_set* writeFds, fd_set* exceptFds, timeval* timeout)
+    {
+        check("select");
+        return real.select(numFds, readFds, writeFds, exceptFds, timeout);
+    }
+}
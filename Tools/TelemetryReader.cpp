@@ -0,0 +1,201 @@
+/*
+  ==============================================================================
+
+    Prints the stats every DubEcho instance a user runs publishes to shared
+    memory, once or every interval. Plain POSIX C++, no JUCE:
+
+        c++ -std=c++17 -O2 Tools/TelemetryReader.cpp -o dubecho-telemetry
+
+    (add -lrt on Linux systems with a glibc older than 2.34)
+
+        dubecho-telemetry              one table and exit
+        dubecho-telemetry -w [ms]      a new table every ms, 1000 by default
+        dubecho-telemetry -c           comma separated, one line per instance
+        dubecho-telemetry -u uid       another user's instances instead of the
+                                       current user's; their segment is private
+                                       to them, so this needs root
+
+    Instances that found every slot taken aren't listed; the table ends with how
+    many there were, and the comma separated output reports them on stderr.
+
+  ==============================================================================
+*/
+
+#include "../Source/TelemetryLayout.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace
+{
+    // An instance that hasn't finished a block for this long isn't being called by its host
+    constexpr uint64_t idleAfterNs = 500000000ull;
+
+    uint64_t monotonicNowNs()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+    }
+
+    const char* describeState(const Telemetry::Stats& stats, uint64_t now)
+    {
+        if (stats.blocksProcessed == 0)
+            return "new";
+
+        if (now > stats.updateTimeNs && now - stats.updateTimeNs > idleAfterNs)
+            return "idle";
+
+        return (stats.flags & Telemetry::outputSilent) != 0 ? "silent" : "active";
+    }
+
+    void printHeader(bool csv)
+    {
+        if (csv)
+            std::printf("pid,instance,state,sample_rate,block_size,blocks,deadline_misses,load,smoothed_load,tier,"
+                        "rms_left,rms_right,delay_time,delay_feedback,delay_wet,reverb_size,reverb_damping,reverb_wet,flags\n");
+        else
+            std::printf("%7s %5s %-6s %7s %5s %10s %7s %6s %6s %-7s %6s %6s  %s\n",
+                        "pid", "inst", "state", "rate", "block", "blocks", "misses", "load%", "avg%", "tier",
+                        "rmsL", "rmsR", "delay time/fb/wet  reverb size/damp/wet  flags");
+    }
+
+    void printStats(int32_t pid, uint32_t instanceId, const Telemetry::Stats& stats, uint64_t now, bool csv)
+    {
+        const auto* state = describeState(stats, now);
+        const auto* tier = stats.qualityTier == 0 ? "high" : "economy";
+
+        if (csv)
+        {
+            std::printf("%d,%u,%s,%.0f,%u,%llu,%llu,%.4f,%.4f,%s,%.1f,%.1f,%.3f,%.2f,%.2f,%.2f,%.2f,%.2f,%u\n",
+                        pid, instanceId, state, stats.sampleRate, stats.blockSize,
+                        (unsigned long long)stats.blocksProcessed, (unsigned long long)stats.deadlineMisses,
+                        stats.lastBlockLoad, stats.smoothedLoad, tier, stats.rmsLeft, stats.rmsRight,
+                        stats.delayTime, stats.delayFeedback, stats.delayWet,
+                        stats.reverbSize, stats.reverbDamping, stats.reverbWet, stats.flags);
+            return;
+        }
+
+        std::printf("%7d %5u %-6s %7.0f %5u %10llu %7llu %6.1f %6.1f %-7s %6.1f %6.1f  %5.2f/%4.2f/%4.2f  %4.2f/%4.2f/%4.2f  %s%s%s\n",
+                    pid, instanceId, state, stats.sampleRate, stats.blockSize,
+                    (unsigned long long)stats.blocksProcessed, (unsigned long long)stats.deadlineMisses,
+                    stats.lastBlockLoad * 100.f, stats.smoothedLoad * 100.f, tier, stats.rmsLeft, stats.rmsRight,
+                    stats.delayTime, stats.delayFeedback, stats.delayWet,
+                    stats.reverbSize, stats.reverbDamping, stats.reverbWet,
+                    (stats.flags & Telemetry::doublePrecision) != 0 ? "f64 " : "",
+                    (stats.flags & Telemetry::delayFrozen) != 0 ? "delay-freeze " : "",
+                    (stats.flags & Telemetry::reverbFrozen) != 0 ? "reverb-freeze" : "");
+    }
+
+    void printSegment(const Telemetry::Segment& segment, bool csv)
+    {
+        const auto now = monotonicNowNs();
+        printHeader(csv);
+
+        for (const auto& slot : segment.slots)
+        {
+            const auto pid = slot.ownerPid.load(std::memory_order_acquire);
+
+            if (pid == 0)
+                continue;
+
+            // The writer finishes a block in microseconds, so a few retries are plenty
+            Telemetry::Stats stats;
+            auto attempts = 0;
+
+            while (! Telemetry::readStats(slot, stats) && ++attempts < 100)
+                usleep(10);
+
+            if (attempts < 100)
+                printStats(pid, slot.instanceId, stats, now, csv);
+        }
+
+        // Counted since the segment was created, so it only ever grows
+        if (const auto dropped = segment.droppedRegistrations.load(std::memory_order_relaxed); dropped > 0)
+            std::fprintf(csv ? stderr : stdout, "%u registrations dropped so far, each finding all %u slots taken\n",
+                         dropped, Telemetry::numSlots);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    auto watchIntervalMs = 0;
+    auto csv = false;
+    auto userId = geteuid();
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "-w") == 0)
+            watchIntervalMs = i + 1 < argc && argv[i + 1][0] != '-' ? std::atoi(argv[++i]) : 1000;
+        else if (std::strcmp(argv[i], "-c") == 0)
+            csv = true;
+        else if (std::strcmp(argv[i], "-u") == 0 && i + 1 < argc)
+            userId = (uid_t)std::strtoul(argv[++i], nullptr, 10);
+        else
+        {
+            std::fprintf(stderr, "usage: %s [-w [ms]] [-c] [-u uid]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    const auto segmentName = Telemetry::getSegmentName((uint32_t)userId);
+    const auto fd = shm_open(segmentName.text, O_RDONLY, 0);
+
+    if (fd < 0)
+    {
+        std::fprintf(stderr, "No DubEcho telemetry readable for user %u (%s)\n", (unsigned)userId, segmentName.text);
+        return 1;
+    }
+
+    // The instances won't write to a segment like this, so whatever is in it isn't theirs
+    struct stat info;
+
+    if (fstat(fd, &info) != 0 || info.st_uid != userId || (info.st_mode & (S_IRWXG | S_IRWXO)) != 0)
+    {
+        std::fprintf(stderr, "%s isn't private to user %u, ignoring it\n", segmentName.text, (unsigned)userId);
+        close(fd);
+        return 1;
+    }
+
+    auto* mapping = mmap(nullptr, sizeof(Telemetry::Segment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        std::perror("mmap");
+        return 1;
+    }
+
+    const auto& segment = *static_cast<const Telemetry::Segment*>(mapping);
+
+    if (segment.magic.load() != Telemetry::magic || segment.version != Telemetry::version)
+    {
+        std::fprintf(stderr, "Telemetry segment has layout version %u, this reader understands %u\n",
+                     segment.version, Telemetry::version);
+        return 1;
+    }
+
+    do
+    {
+        printSegment(segment, csv);
+        std::fflush(stdout);
+
+        if (watchIntervalMs > 0)
+        {
+            usleep((useconds_t)watchIntervalMs * 1000);
+
+            if (! csv)
+                std::printf("\n");
+        }
+    }
+    while (watchIntervalMs > 0);
+
+    munmap(mapping, sizeof(Telemetry::Segment));
+    return 0;
+}